@@ -1,213 +1,313 @@
 #pragma once
-#include <string>
-#include <memory>
-#include <vector>
+#include "cps/Interner.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Casting.h"
 #include <cstdint>
+#include <utility>
 
 namespace cps {
 
+struct TypeInfo;
+
+// Nodes are allocated from an ASTContext and never destroyed individually:
+// children are plain pointers, child lists are spans into the same arena,
+// and strings are StringRefs into the source buffer, the Interner or the
+// arena.
+//
+// Each node records its concrete class in a kind tag, which backs LLVM-style
+// isa<>/cast<>/dyn_cast<> through the classof() hooks and lets codegen
+// dispatch with a switch instead of trying each class in turn. Sema fills
+// in each expression's type before codegen runs.
+
 class ExprAST {
 public:
-    virtual ~ExprAST() = default;
+    enum ExprKind {
+        EK_Integer,
+        EK_Real,
+        EK_Boolean,
+        EK_Char,
+        EK_String,
+        EK_Variable,
+        EK_ArrayAccess,
+        EK_Unary,
+        EK_Binary,
+        EK_Call
+    };
+
+private:
+    const ExprKind Kind;
+    const TypeInfo *Type = nullptr;
+
+protected:
+    ExprAST(ExprKind Kind) : Kind(Kind) {}
+
+public:
+    ExprKind getKind() const { return Kind; }
+
+    // Null until Sema has run, and left null where the type is unknown.
+    const TypeInfo *getType() const { return Type; }
+    void setType(const TypeInfo *T) { Type = T; }
 };
 
 class IntegerExprAST : public ExprAST {
     int64_t Val;
 public:
-    IntegerExprAST(int64_t Val) : Val(Val) {}
+    IntegerExprAST(int64_t Val) : ExprAST(EK_Integer), Val(Val) {}
     int64_t getVal() const { return Val; }
+
+    static bool classof(const ExprAST *E) { return E->getKind() == EK_Integer; }
 };
 
 class RealExprAST : public ExprAST {
     double Val;
 public:
-    RealExprAST(double Val) : Val(Val) {}
+    RealExprAST(double Val) : ExprAST(EK_Real), Val(Val) {}
     double getVal() const { return Val; }
+
+    static bool classof(const ExprAST *E) { return E->getKind() == EK_Real; }
 };
 
 class BooleanExprAST : public ExprAST {
     bool Val;
 public:
-    BooleanExprAST(bool Val) : Val(Val) {}
+    BooleanExprAST(bool Val) : ExprAST(EK_Boolean), Val(Val) {}
     bool getVal() const { return Val; }
+
+    static bool classof(const ExprAST *E) { return E->getKind() == EK_Boolean; }
 };
 
 class CharExprAST : public ExprAST {
     char Val;
 public:
-    CharExprAST(char Val) : Val(Val) {}
+    CharExprAST(char Val) : ExprAST(EK_Char), Val(Val) {}
     char getVal() const { return Val; }
+
+    static bool classof(const ExprAST *E) { return E->getKind() == EK_Char; }
 };
 
 class StringExprAST : public ExprAST {
-    std::string Val;
+    llvm::StringRef Val;
 public:
-    StringExprAST(const std::string &Val) : Val(Val) {}
-    const std::string &getVal() const { return Val; }
+    StringExprAST(llvm::StringRef Val) : ExprAST(EK_String), Val(Val) {}
+    llvm::StringRef getVal() const { return Val; }
+
+    static bool classof(const ExprAST *E) { return E->getKind() == EK_String; }
 };
 
 class VariableExprAST : public ExprAST {
-    std::string Name;
+    SymbolID Name;
 public:
-    VariableExprAST(const std::string &Name) : Name(Name) {}
-    const std::string &getName() const { return Name; }
+    VariableExprAST(SymbolID Name) : ExprAST(EK_Variable), Name(Name) {}
+    SymbolID getNameID() const { return Name; }
+
+    static bool classof(const ExprAST *E) { return E->getKind() == EK_Variable; }
 };
 
 class ArrayAccessExprAST : public ExprAST {
-    std::string Name;
-    std::vector<std::unique_ptr<ExprAST>> Indices;
+    SymbolID Name;
+    llvm::ArrayRef<ExprAST *> Indices;
     int Line;
 public:
-    ArrayAccessExprAST(const std::string &Name, std::vector<std::unique_ptr<ExprAST>> Indices, int Line)
-        : Name(Name), Indices(std::move(Indices)), Line(Line) {}
-    const std::string &getName() const { return Name; }
-    const std::vector<std::unique_ptr<ExprAST>> &getIndices() const { return Indices; }
+    ArrayAccessExprAST(SymbolID Name, llvm::ArrayRef<ExprAST *> Indices, int Line)
+        : ExprAST(EK_ArrayAccess), Name(Name), Indices(Indices), Line(Line) {}
+    SymbolID getNameID() const { return Name; }
+    llvm::ArrayRef<ExprAST *> getIndices() const { return Indices; }
     int getLine() const { return Line; }
+
+    static bool classof(const ExprAST *E) { return E->getKind() == EK_ArrayAccess; }
 };
 
 class UnaryExprAST : public ExprAST {
     int Op;
-    std::unique_ptr<ExprAST> Operand;
+    ExprAST *Operand;
 public:
-    UnaryExprAST(int Op, std::unique_ptr<ExprAST> Operand)
-        : Op(Op), Operand(std::move(Operand)) {}
+    UnaryExprAST(int Op, ExprAST *Operand)
+        : ExprAST(EK_Unary), Op(Op), Operand(Operand) {}
     int getOp() const { return Op; }
-    ExprAST *getOperand() const { return Operand.get(); }
+    ExprAST *getOperand() const { return Operand; }
+
+    static bool classof(const ExprAST *E) { return E->getKind() == EK_Unary; }
 };
 
 class BinaryExprAST : public ExprAST {
     int Op;
-    std::unique_ptr<ExprAST> LHS, RHS;
+    ExprAST *LHS, *RHS;
     int Line;
 public:
-    BinaryExprAST(int Op, std::unique_ptr<ExprAST> LHS, std::unique_ptr<ExprAST> RHS, int Line)
-        : Op(Op), LHS(std::move(LHS)), RHS(std::move(RHS)), Line(Line) {}
+    BinaryExprAST(int Op, ExprAST *LHS, ExprAST *RHS, int Line)
+        : ExprAST(EK_Binary), Op(Op), LHS(LHS), RHS(RHS), Line(Line) {}
     int getOp() const { return Op; }
-    ExprAST *getLHS() const { return LHS.get(); }
-    ExprAST *getRHS() const { return RHS.get(); }
+    ExprAST *getLHS() const { return LHS; }
+    ExprAST *getRHS() const { return RHS; }
     int getLine() const { return Line; }
+
+    static bool classof(const ExprAST *E) { return E->getKind() == EK_Binary; }
 };
 
 class StmtAST {
 public:
-    virtual ~StmtAST() = default;
+    enum StmtKind {
+        SK_Declare,
+        SK_ArrayDeclare,
+        SK_Assign,
+        SK_ArrayAssign,
+        SK_Input,
+        SK_Output,
+        SK_If,
+        SK_While,
+        SK_Repeat,
+        SK_For,
+        SK_FunctionDef,
+        SK_Call,
+        SK_Return
+    };
+
+private:
+    const StmtKind Kind;
+
+protected:
+    StmtAST(StmtKind Kind) : Kind(Kind) {}
+
+public:
+    StmtKind getKind() const { return Kind; }
 };
 
 class DeclareStmtAST : public StmtAST {
-    std::string Name;
-    std::string Type;
+    SymbolID Name;
+    llvm::StringRef Type;
 public:
-    DeclareStmtAST(const std::string &Name, const std::string &Type = "INTEGER") 
-        : Name(Name), Type(Type) {}
-    const std::string &getName() const { return Name; }
-    const std::string &getType() const { return Type; }
+    DeclareStmtAST(SymbolID Name, llvm::StringRef Type = "INTEGER") 
+        : StmtAST(SK_Declare), Name(Name), Type(Type) {}
+    SymbolID getNameID() const { return Name; }
+    llvm::StringRef getType() const { return Type; }
+
+    static bool classof(const StmtAST *S) { return S->getKind() == SK_Declare; }
 };
 
 class ArrayDeclareStmtAST : public StmtAST {
-    std::string Name;
-    std::vector<std::pair<std::unique_ptr<ExprAST>, std::unique_ptr<ExprAST>>> Bounds; 
-    std::string Type;
-public:
-    ArrayDeclareStmtAST(const std::string &Name, 
-        std::vector<std::pair<std::unique_ptr<ExprAST>, std::unique_ptr<ExprAST>>> Bounds,
-        const std::string &Type)
-        : Name(Name), Bounds(std::move(Bounds)), Type(Type) {}
+    SymbolID Name;
+    llvm::ArrayRef<std::pair<ExprAST *, ExprAST *>> Bounds; 
+    llvm::StringRef Type;
+public:
+    ArrayDeclareStmtAST(SymbolID Name, 
+        llvm::ArrayRef<std::pair<ExprAST *, ExprAST *>> Bounds,
+        llvm::StringRef Type)
+        : StmtAST(SK_ArrayDeclare), Name(Name), Bounds(Bounds), Type(Type) {}
     
-    const std::string &getName() const { return Name; }
-    const std::vector<std::pair<std::unique_ptr<ExprAST>, std::unique_ptr<ExprAST>>> &getBounds() const { return Bounds; }
-    const std::string &getType() const { return Type; }
+    SymbolID getNameID() const { return Name; }
+    llvm::ArrayRef<std::pair<ExprAST *, ExprAST *>> getBounds() const { return Bounds; }
+    llvm::StringRef getType() const { return Type; }
+
+    static bool classof(const StmtAST *S) { return S->getKind() == SK_ArrayDeclare; }
 };
 
 class AssignStmtAST : public StmtAST {
-    std::string Name;
-    std::unique_ptr<ExprAST> Expr;
+    SymbolID Name;
+    ExprAST *Expr;
 public:
-    AssignStmtAST(const std::string &Name, std::unique_ptr<ExprAST> Expr)
-        : Name(Name), Expr(std::move(Expr)) {}
-    const std::string &getName() const { return Name; }
-    ExprAST *getExpr() const { return Expr.get(); }
+    AssignStmtAST(SymbolID Name, ExprAST *Expr)
+        : StmtAST(SK_Assign), Name(Name), Expr(Expr) {}
+    SymbolID getNameID() const { return Name; }
+    ExprAST *getExpr() const { return Expr; }
+
+    static bool classof(const StmtAST *S) { return S->getKind() == SK_Assign; }
 };
 
 class ArrayAssignStmtAST : public StmtAST {
-    std::string Name;
-    std::vector<std::unique_ptr<ExprAST>> Indices;
-    std::unique_ptr<ExprAST> Expr;
+    SymbolID Name;
+    llvm::ArrayRef<ExprAST *> Indices;
+    ExprAST *Expr;
     int Line;
 public:
-    ArrayAssignStmtAST(const std::string &Name, std::vector<std::unique_ptr<ExprAST>> Indices, std::unique_ptr<ExprAST> Expr, int Line)
-        : Name(Name), Indices(std::move(Indices)), Expr(std::move(Expr)), Line(Line) {}
-    const std::string &getName() const { return Name; }
-    const std::vector<std::unique_ptr<ExprAST>> &getIndices() const { return Indices; }
-    ExprAST *getExpr() const { return Expr.get(); }
+    ArrayAssignStmtAST(SymbolID Name, llvm::ArrayRef<ExprAST *> Indices, ExprAST *Expr, int Line)
+        : StmtAST(SK_ArrayAssign), Name(Name), Indices(Indices), Expr(Expr), Line(Line) {}
+    SymbolID getNameID() const { return Name; }
+    llvm::ArrayRef<ExprAST *> getIndices() const { return Indices; }
+    ExprAST *getExpr() const { return Expr; }
     int getLine() const { return Line; }
+
+    static bool classof(const StmtAST *S) { return S->getKind() == SK_ArrayAssign; }
 };
 
 class InputStmtAST : public StmtAST {
-    std::string Name;
+    SymbolID Name;
 public:
-    InputStmtAST(const std::string &Name) : Name(Name) {}
-    const std::string &getName() const { return Name; }
+    InputStmtAST(SymbolID Name) : StmtAST(SK_Input), Name(Name) {}
+    SymbolID getNameID() const { return Name; }
+
+    static bool classof(const StmtAST *S) { return S->getKind() == SK_Input; }
 };
 
 class OutputStmtAST : public StmtAST {
-    std::unique_ptr<ExprAST> Expr;
+    ExprAST *Expr;
 public:
-    OutputStmtAST(std::unique_ptr<ExprAST> Expr) : Expr(std::move(Expr)) {}
-    ExprAST *getExpr() const { return Expr.get(); }
+    OutputStmtAST(ExprAST *Expr) : StmtAST(SK_Output), Expr(Expr) {}
+    ExprAST *getExpr() const { return Expr; }
+
+    static bool classof(const StmtAST *S) { return S->getKind() == SK_Output; }
 };
 
 class IfStmtAST : public StmtAST {
-    std::unique_ptr<ExprAST> Cond;
-    std::vector<std::unique_ptr<StmtAST>> ThenStmts;
-    std::vector<std::unique_ptr<StmtAST>> ElseStmts;
+    ExprAST *Cond;
+    llvm::ArrayRef<StmtAST *> ThenStmts;
+    llvm::ArrayRef<StmtAST *> ElseStmts;
 public:
-    IfStmtAST(std::unique_ptr<ExprAST> Cond,
-              std::vector<std::unique_ptr<StmtAST>> ThenStmts,
-              std::vector<std::unique_ptr<StmtAST>> ElseStmts)
-        : Cond(std::move(Cond)), ThenStmts(std::move(ThenStmts)), ElseStmts(std::move(ElseStmts)) {}
+    IfStmtAST(ExprAST *Cond,
+              llvm::ArrayRef<StmtAST *> ThenStmts,
+              llvm::ArrayRef<StmtAST *> ElseStmts)
+        : StmtAST(SK_If), Cond(Cond), ThenStmts(ThenStmts), ElseStmts(ElseStmts) {}
+
+    ExprAST *getCond() const { return Cond; }
+    llvm::ArrayRef<StmtAST *> getThenStmts() const { return ThenStmts; }
+    llvm::ArrayRef<StmtAST *> getElseStmts() const { return ElseStmts; }
 
-    ExprAST *getCond() const { return Cond.get(); }
-    const std::vector<std::unique_ptr<StmtAST>> &getThenStmts() const { return ThenStmts; }
-    const std::vector<std::unique_ptr<StmtAST>> &getElseStmts() const { return ElseStmts; }
+    static bool classof(const StmtAST *S) { return S->getKind() == SK_If; }
 };
 
 class WhileStmtAST : public StmtAST {
-    std::unique_ptr<ExprAST> Cond;
-    std::vector<std::unique_ptr<StmtAST>> Body;
+    ExprAST *Cond;
+    llvm::ArrayRef<StmtAST *> Body;
 public:
-    WhileStmtAST(std::unique_ptr<ExprAST> Cond, std::vector<std::unique_ptr<StmtAST>> Body)
-        : Cond(std::move(Cond)), Body(std::move(Body)) {}
-    ExprAST *getCond() const { return Cond.get(); }
-    const std::vector<std::unique_ptr<StmtAST>> &getBody() const { return Body; }
+    WhileStmtAST(ExprAST *Cond, llvm::ArrayRef<StmtAST *> Body)
+        : StmtAST(SK_While), Cond(Cond), Body(Body) {}
+    ExprAST *getCond() const { return Cond; }
+    llvm::ArrayRef<StmtAST *> getBody() const { return Body; }
+
+    static bool classof(const StmtAST *S) { return S->getKind() == SK_While; }
 };
 
 class RepeatStmtAST : public StmtAST {
-    std::vector<std::unique_ptr<StmtAST>> Body;
-    std::unique_ptr<ExprAST> Cond;
+    llvm::ArrayRef<StmtAST *> Body;
+    ExprAST *Cond;
 public:
-    RepeatStmtAST(std::vector<std::unique_ptr<StmtAST>> Body, std::unique_ptr<ExprAST> Cond)
-        : Body(std::move(Body)), Cond(std::move(Cond)) {}
-    ExprAST *getCond() const { return Cond.get(); }
-    const std::vector<std::unique_ptr<StmtAST>> &getBody() const { return Body; }
+    RepeatStmtAST(llvm::ArrayRef<StmtAST *> Body, ExprAST *Cond)
+        : StmtAST(SK_Repeat), Body(Body), Cond(Cond) {}
+    ExprAST *getCond() const { return Cond; }
+    llvm::ArrayRef<StmtAST *> getBody() const { return Body; }
+
+    static bool classof(const StmtAST *S) { return S->getKind() == SK_Repeat; }
 };
 
 class ForStmtAST : public StmtAST {
-    std::string VarName;
-    std::unique_ptr<ExprAST> Start;
-    std::unique_ptr<ExprAST> End;
-    std::unique_ptr<ExprAST> Step;
-    std::vector<std::unique_ptr<StmtAST>> Body;
-public:
-    ForStmtAST(const std::string &VarName, std::unique_ptr<ExprAST> Start, 
-               std::unique_ptr<ExprAST> End, std::unique_ptr<ExprAST> Step,
-               std::vector<std::unique_ptr<StmtAST>> Body)
-        : VarName(VarName), Start(std::move(Start)), End(std::move(End)), 
-          Step(std::move(Step)), Body(std::move(Body)) {}
-    const std::string &getVarName() const { return VarName; }
-    ExprAST *getStart() const { return Start.get(); }
-    ExprAST *getEnd() const { return End.get(); }
-    ExprAST *getStep() const { return Step.get(); }
-    const std::vector<std::unique_ptr<StmtAST>> &getBody() const { return Body; }
+    SymbolID VarName;
+    ExprAST *Start;
+    ExprAST *End;
+    ExprAST *Step;
+    llvm::ArrayRef<StmtAST *> Body;
+public:
+    ForStmtAST(SymbolID VarName, ExprAST *Start, 
+               ExprAST *End, ExprAST *Step,
+               llvm::ArrayRef<StmtAST *> Body)
+        : StmtAST(SK_For), VarName(VarName), Start(Start), End(End), 
+          Step(Step), Body(Body) {}
+    SymbolID getVarNameID() const { return VarName; }
+    ExprAST *getStart() const { return Start; }
+    ExprAST *getEnd() const { return End; }
+    ExprAST *getStep() const { return Step; }
+    llvm::ArrayRef<StmtAST *> getBody() const { return Body; }
+
+    static bool classof(const StmtAST *S) { return S->getKind() == SK_For; }
 };
 
 } // namespace cps
@@ -0,0 +1,57 @@
+#pragma once
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace cps {
+
+// Owns a compilation's AST: every node, child list and string the parser
+// creates comes from one bump-pointer arena. Nodes are never destroyed one
+// at a time; the whole tree is released with the context or by reset(), so
+// anything a node holds must be trivially destructible (other nodes, spans,
+// StringRefs).
+class ASTContext {
+    llvm::BumpPtrAllocator Arena;
+
+public:
+    ASTContext() = default;
+    ASTContext(const ASTContext &) = delete;
+    ASTContext &operator=(const ASTContext &) = delete;
+
+    template <typename T, typename... ArgTs>
+    T *create(ArgTs &&...Args) {
+        return new (Arena.Allocate<T>()) T(std::forward<ArgTs>(Args)...);
+    }
+
+    // Copies a list built up during parsing into the arena.
+    template <typename T>
+    llvm::ArrayRef<T> copyList(const llvm::SmallVectorImpl<T> &Elts) {
+        static_assert(std::is_trivially_destructible<T>::value,
+                      "AST lists are never destroyed");
+        if (Elts.empty()) return {};
+        T *Mem = Arena.Allocate<T>(Elts.size());
+        std::uninitialized_copy(Elts.begin(), Elts.end(), Mem);
+        return llvm::ArrayRef<T>(Mem, Elts.size());
+    }
+
+    // Returns a NUL-terminated copy of S that lives as long as the tree.
+    llvm::StringRef copyString(llvm::StringRef S) {
+        char *Mem = Arena.Allocate<char>(S.size() + 1);
+        if (!S.empty()) memcpy(Mem, S.data(), S.size());
+        Mem[S.size()] = '\0';
+        return llvm::StringRef(Mem, S.size());
+    }
+
+    // Releases every node created so far, keeping the first slab for the
+    // next tree. Nothing may refer to the old tree afterwards.
+    void reset() { Arena.Reset(); }
+
+    size_t getBytesAllocated() const { return Arena.getBytesAllocated(); }
+};
+
+} // namespace cps
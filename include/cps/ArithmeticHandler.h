@@ -1,6 +1,7 @@
 #pragma once
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
+#include "cps/Diagnostics.h"
 #include "cps/Lexer.h"
 
 namespace cps {
@@ -8,10 +9,11 @@ namespace cps {
 class ArithmeticHandler {
     llvm::LLVMContext &Context;
     llvm::IRBuilder<> &Builder;
+    DiagnosticEngine &Diags;
 
 public:
-    ArithmeticHandler(llvm::LLVMContext &Ctx, llvm::IRBuilder<> &B)
-        : Context(Ctx), Builder(B) {}
+    ArithmeticHandler(llvm::LLVMContext &Ctx, llvm::IRBuilder<> &B, DiagnosticEngine &D)
+        : Context(Ctx), Builder(B), Diags(D) {}
 
     llvm::Value *emitBinaryOp(int Op, llvm::Value *LHS, llvm::Value *RHS, int Line);
 };
@@ -3,10 +3,10 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "cps/AST.h"
+#include "cps/Interner.h"
 #include "cps/RuntimeCheck.h"
 #include "cps/TypeSystem.h"
 #include <cstdint>
-#include <map>
 #include <string>
 #include <vector>
 
@@ -28,21 +28,22 @@ class ArrayHandler {
     llvm::LLVMContext *TheContext;
     llvm::IRBuilder<> *Builder;
     llvm::Module *TheModule;
-    std::map<std::string, llvm::Value*> *NamedValues;
-    std::map<std::string, SymbolInfo> *Symbols;
+    const Interner &Names;
+    const SymbolTable &Symbols;
     TypeSystem &Types;
 
-    std::map<std::string, ArrayMetadata> ArrayTable;
+    // Indexed by SymbolID; Rank 0 marks a name that is not an array.
+    std::vector<ArrayMetadata> ArrayTable;
     RuntimeCheck &RuntimeChecker;
 
     llvm::FunctionCallee MallocFunc;
     llvm::FunctionCallee FreeFunc;
 
-    llvm::Value *computeFlatIndex(const std::string &Name, const std::vector<llvm::Value*> &Indices);
-    llvm::Value *getArrayBasePointer(const std::string &Name);
-    llvm::Value *getElementPointer(const std::string &Name, llvm::Value *Offset);
-    const ArrayMetadata *getMetadata(const std::string &Name) const;
-    void emitPrintLoop(const std::string &Name,
+    llvm::Value *computeFlatIndex(SymbolID Name, const std::vector<llvm::Value*> &Indices);
+    llvm::Value *getArrayBasePointer(SymbolID Name);
+    llvm::Value *getElementPointer(SymbolID Name, llvm::Value *Offset);
+    const ArrayMetadata *getMetadata(SymbolID Name) const;
+    void emitPrintLoop(SymbolID Name,
                        int CurrentDim,
                        std::vector<llvm::Value*> CurrentIndices,
                        CodeGen &CG);
@@ -51,8 +52,8 @@ public:
     ArrayHandler(llvm::LLVMContext &C,
                  llvm::IRBuilder<> &B,
                  llvm::Module &M,
-                 std::map<std::string, llvm::Value*> &NV,
-                 std::map<std::string, SymbolInfo> &Sym,
+                 const Interner &N,
+                 const SymbolTable &Sym,
                  TypeSystem &TS,
                  RuntimeCheck &RC);
 
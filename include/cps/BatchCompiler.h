@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace cps {
+
+class ObjectEmitter;
+
+struct BatchResult {
+    std::string InputPath;
+    std::string OutputPath;
+    bool Ok = false;
+    unsigned NumErrors = 0; // compile errors reported for this input
+    double Seconds = 0;
+};
+
+// Compiles many programs in one process, one native object per input.
+// Each worker thread owns its TargetMachine and builds a fresh
+// LLVMContext/Module/CodeGen per file; inputs are handed out from a shared
+// atomic cursor so the load balances across uneven file sizes.
+class BatchCompiler {
+    unsigned OptLevel;
+    unsigned NumWorkers;
+    std::string OutputDir;
+
+    BatchResult compileFile(ObjectEmitter &Emitter, const std::string &InputPath) const;
+
+public:
+    BatchCompiler(unsigned OptLevel, unsigned NumWorkers, std::string OutputDir = "");
+
+    // Results are returned in the order of Inputs. Inputs whose objects
+    // would land on the same path fail without being compiled. Diagnostics
+    // are printed prefixed with the input's path.
+    std::vector<BatchResult> run(const std::vector<std::string> &Inputs) const;
+
+    // Appends the non-empty lines of the manifest at Path to Inputs.
+    static bool readManifest(const std::string &Path, std::vector<std::string> &Inputs);
+
+    // foo/bar.cps -> foo/bar.o, or OutputDir/bar.o when OutputDir is set.
+    std::string getOutputPath(const std::string &InputPath) const;
+
+    static void printSummary(const std::vector<BatchResult> &Results, double WallSeconds, FILE *Out);
+};
+
+} // namespace cps
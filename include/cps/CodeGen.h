@@ -3,8 +3,11 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "cps/AST.h"
+#include "cps/Diagnostics.h"
 #include "cps/RuntimeCheck.h"
 #include "cps/FunctionGen.h"
+#include "cps/Interner.h"
+#include "cps/TimeReport.h"
 #include "cps/TypeSystem.h"
 
 #include "cps/IntegerHandler.h"
@@ -15,9 +18,13 @@
 #include "cps/CharHandler.h"
 #include "cps/StringConversionHandler.h"
 
-#include <map>
 #include <memory>
 #include <string>
+#include <vector>
+
+namespace llvm {
+class TargetMachine;
+}
 
 namespace cps {
 
@@ -27,13 +34,18 @@ class CodeGen {
     std::unique_ptr<llvm::LLVMContext> TheContext;
     std::unique_ptr<llvm::Module> TheModule;
     std::unique_ptr<llvm::IRBuilder<>> Builder;
-    std::map<std::string, llvm::Value*> NamedValues;
-    std::map<std::string, SymbolInfo> Symbols;
+    const Interner &Names;
+    DiagnosticEngine &Diags;
+
+    // Shared with ArrayHandler and FunctionGen.
+    SymbolTable Symbols;
     std::unique_ptr<TypeSystem> Types;
     
     std::unique_ptr<ArrayHandler> Arrays;
     std::unique_ptr<RuntimeCheck> RuntimeChecker;
     std::unique_ptr<FunctionGen> FuncGen;
+    TimeReport *Timer = nullptr;
+    size_t MainPhase = 0;
 
     std::unique_ptr<IntegerHandler> IntHandler;
     std::unique_ptr<RealHandler> RealHelper;
@@ -60,14 +72,20 @@ class CodeGen {
     llvm::Value *EmptyStringStr;        // ""
 
     void SetupExternalFunctions();
-    llvm::AllocaInst *CreateEntryBlockAlloca(llvm::Function *TheFunction, const std::string &VarName);
-    llvm::AllocaInst *CreateEntryBlockAlloca(llvm::Function *TheFunction, llvm::Type *AllocType, const std::string &VarName);
+    llvm::AllocaInst *CreateEntryBlockAlloca(llvm::Function *TheFunction, const llvm::Twine &VarName);
+    llvm::AllocaInst *CreateEntryBlockAlloca(llvm::Function *TheFunction, llvm::Type *AllocType, const llvm::Twine &VarName);
 
-    void registerSymbol(const std::string &Name, llvm::Value *Storage, const std::string &TypeName, bool IsArray = false);
-    const SymbolInfo *getSymbolInfo(const std::string &Name) const;
-    const TypeInfo *getExprTypeInfo(ExprAST *Expr) const;
+    void registerSymbol(SymbolID Name, llvm::Value *Storage, const TypeInfo *Type, bool IsArray = false,
+                        llvm::Value *Capacity = nullptr);
+    const SymbolInfo *getSymbolInfo(SymbolID Name) const;
     llvm::Value *coerceValueToType(llvm::Value *Val, const TypeInfo *TargetInfo);
     void emitDeclareStmt(DeclareStmtAST *Stmt);
+    // A STRING variable gives up its buffer whenever its value may be
+    // shared or replaced behind codegen's back: when it is assigned,
+    // returned, stored in an array or passed to a call.
+    void releaseString(ExprAST *Expr);
+    void releaseString(const SymbolInfo *Info);
+    bool tryEmitStringAppend(AssignStmtAST *Assign);
     void emitOutputValue(llvm::Value *Val, const TypeInfo *TypeInfo, bool AppendNewline = true);
 
     void emitIfStmt(IfStmtAST *Stmt);
@@ -76,17 +94,35 @@ class CodeGen {
     void emitForStmt(ForStmtAST *Stmt);
 
 public:
-    CodeGen();
+    // Names must be the interner the AST was parsed with and outlive this,
+    // as must Diags, which receives the errors Sema cannot catch.
+    CodeGen(const Interner &Names, DiagnosticEngine &Diags);
     ~CodeGen();
-    void compile(const std::vector<std::unique_ptr<StmtAST>> &Statements);
+    // Reports codegen per FUNCTION/PROCEDURE, verification and optimization.
+    void setTimeReport(TimeReport *T);
+    // The program is lowered one top-level statement at a time, in source
+    // order, between beginMain() and finishMain(). Each statement must have
+    // been through Sema with getTypes(), which has reported any errors;
+    // codegen skips what it cannot lower. Nothing refers to a statement
+    // once emitTopLevel() returns, so its tree can be freed.
+    void beginMain();
+    void emitTopLevel(StmtAST *Stmt);
+    void finishMain();
+    // TM, when given, supplies the target's cost model to the pipeline.
+    bool optimize(unsigned OptLevel, llvm::TargetMachine *TM = nullptr);
     void print();
+
+    const TypeSystem &getTypes() const { return *Types; }
+    llvm::Module &getModule() { return *TheModule; }
+    std::unique_ptr<llvm::Module> takeModule() { return std::move(TheModule); }
+    std::unique_ptr<llvm::LLVMContext> takeContext() { return std::move(TheContext); }
     
     llvm::Value *emitExpr(ExprAST *Expr);
     void emitStmt(StmtAST *Stmt);
 
     const TypeInfo *resolveType(const std::string &TypeName) const;
     llvm::Type *getLLVMType(const std::string &TypeName) const;
-    llvm::Value *getNamedValue(const std::string &Name) const;
+    llvm::Value *getNamedValue(SymbolID Name) const;
     
     friend class ArrayHandler;
 };
@@ -0,0 +1,55 @@
+#pragma once
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+#include <string>
+
+namespace cps {
+
+enum class CacheEntryKind {
+    Object,  // native object for -c / -o
+    Bitcode  // optimized module for IR output and the JIT modes
+};
+
+struct CacheStats {
+    uint64_t Hits = 0;
+    uint64_t Misses = 0;
+    uint64_t Evictions = 0;
+};
+
+// Content-addressed store of compiled programs keyed by the SHA-256 of the
+// source text, the compiler flags, the compiler build (version plus the
+// executable's identity, so a rebuilt compiler starts afresh), the LLVM
+// version and the host. Only compiles without errors are stored.
+// Entries are written atomically (temp file + rename) and evicted in
+// least-recently-used order once the directory exceeds MaxBytes. Temp
+// files a crashed writer left behind are removed once an hour old.
+class CompileCache {
+    std::string Dir;
+    uint64_t MaxBytes;
+    bool Valid = false;
+
+    std::string getEntryPath(const std::string &Key, CacheEntryKind Kind) const;
+    std::string getStatsPath() const;
+    bool writeAtomically(const std::string &Path, llvm::ArrayRef<char> Data) const;
+    void updateStats(uint64_t Hits, uint64_t Misses, uint64_t Evictions) const;
+    uint64_t evictToLimit() const;
+
+public:
+    CompileCache(std::string Dir, uint64_t MaxBytes);
+
+    bool isValid() const { return Valid; }
+    const std::string &getDir() const { return Dir; }
+
+    static std::string getDefaultDir();
+    static std::string computeKey(llvm::StringRef Source, llvm::StringRef Flags);
+
+    // Fills Data and refreshes the entry's LRU timestamp on a hit.
+    bool lookup(const std::string &Key, CacheEntryKind Kind, llvm::SmallVectorImpl<char> &Data) const;
+    bool store(const std::string &Key, CacheEntryKind Kind, llvm::ArrayRef<char> Data) const;
+
+    CacheStats loadStats() const;
+};
+
+} // namespace cps
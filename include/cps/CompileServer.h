@@ -0,0 +1,72 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cps {
+
+enum class RequestMode : uint8_t {
+    Object = 0, // return the native object file
+    Run = 1     // JIT the program and return what it printed
+};
+
+struct CompileRequest {
+    RequestMode Mode = RequestMode::Object;
+    unsigned OptLevel = 0;
+    std::string Source;
+    std::string Input; // stdin for the program in Run mode
+};
+
+struct CompileResponse {
+    bool Ok = false;
+    int ExitCode = 0;
+    std::string Payload; // object bytes, program output, or an error message
+};
+
+// Largest source or stdin, in bytes, a request may carry. The server
+// refuses bigger fields before allocating them.
+constexpr uint32_t MaxRequestFieldSize = 64u << 20;
+
+// Compiles one request in a fresh LLVMContext. Thread-safe. A Run-mode
+// program is executed by spawning RunnerPath, a cpsc binary, with
+// --run-bitcode, and is killed if still running after RunTimeoutSeconds.
+// Compile errors are returned in the payload of a failed response.
+CompileResponse processRequest(const CompileRequest &Req, const std::string &RunnerPath,
+                               unsigned RunTimeoutSeconds);
+
+// Keeps LLVM initialized and serves compile requests over a Unix domain
+// socket, one connection per request, on a fixed pool of worker threads.
+class CompileServer {
+    std::string SocketPath;
+    unsigned NumWorkers;
+    unsigned RunTimeoutSeconds;
+    std::string RunnerPath; // this executable, which runs Run-mode programs
+    int ListenFD = -1;
+
+    std::mutex QueueMutex;
+    std::condition_variable QueueCV;
+    std::deque<int> PendingClients;
+    std::vector<std::thread> Workers;
+
+    void workerLoop();
+    void handleClient(int ClientFD);
+
+public:
+    // Each Run request may use a worker for at most RunTimeoutSeconds of
+    // wall time, so a program that never ends cannot hold one forever.
+    CompileServer(std::string SocketPath, unsigned NumWorkers, unsigned RunTimeoutSeconds);
+    ~CompileServer();
+
+    // Binds the socket and serves requests until the process is killed.
+    // Returns non-zero if the socket could not be set up.
+    int run();
+};
+
+// Client side of the protocol: sends Req to the server at SocketPath.
+bool sendCompileRequest(const std::string &SocketPath, const CompileRequest &Req, CompileResponse &Resp);
+
+} // namespace cps
@@ -0,0 +1,64 @@
+#pragma once
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "cps/Diagnostics.h"
+#include "cps/TimeReport.h"
+#include <functional>
+#include <memory>
+#include <string_view>
+
+namespace cps {
+
+class ObjectEmitter;
+
+enum class CompileOutput {
+    Module, // stop after optimization and hand back the module
+    Object  // also emit a native object into CompileResult::Object
+};
+
+struct CompileOptions {
+    unsigned OptLevel = 0;
+    CompileOutput Output = CompileOutput::Module;
+
+    // Reused for Object output when set; otherwise compile() creates one.
+    // A TargetMachine is not thread-safe, so share it only within a thread.
+    ObjectEmitter *Emitter = nullptr;
+
+    // For Object output, splits the module into this many parts that are
+    // optimized and emitted on their own threads and then partially linked
+    // into one object. Functions are not inlined across parts.
+    unsigned CodeGenThreads = 1;
+
+    // Called on the fresh module before it is optimized, e.g. to stamp the
+    // JIT's triple and data layout. Ignored for Object output.
+    std::function<void(llvm::Module &)> ConfigureModule;
+
+    // Receives each error the compile reports, as "Error: <text>\n", when
+    // set; otherwise errors are written to stderr. Called on the compiling
+    // thread, or on lexer threads for a large buffer, never concurrently.
+    DiagnosticEngine::Handler OnError;
+
+    // Receives per-phase timings (lex, parse, codegen, verify, optimize,
+    // split, emit) when set.
+    TimeReport *Timer = nullptr;
+};
+
+struct CompileResult {
+    // False if any error was reported, the module failed verification or
+    // the object could not be emitted. A module is still returned so that
+    // it can be printed; an object only if there were no errors.
+    bool Ok = false;
+    // Errors reported by the lexer, parser, Sema and codegen.
+    unsigned NumErrors = 0;
+    std::unique_ptr<llvm::LLVMContext> Context;
+    std::unique_ptr<llvm::Module> Module;
+    llvm::SmallVector<char, 0> Object;
+};
+
+// Compiles one program held in Source. All lexer, parser and codegen state
+// lives in this call and the returned context, so any number of compiles can
+// run at once on different threads. Source is only read during the call.
+CompileResult compile(std::string_view Source, const CompileOptions &Opts);
+
+} // namespace cps
@@ -0,0 +1,32 @@
+#pragma once
+#include "cps/AST.h"
+#include "cps/ASTContext.h"
+#include "llvm/ADT/ArrayRef.h"
+
+namespace cps {
+
+// Evaluates operations on literals while the parser builds the tree, so
+// that e.g. 10 * 4 + 2, NOT TRUE, "a" & "b" or UCASE("abc") reach codegen
+// as a single literal instead of IR (and, for strings, malloc and libc
+// calls the optimizer cannot see through). Folding works bottom-up as
+// nodes are created, so nested constant subexpressions collapse fully.
+//
+// Results match what codegen would compute at run time bit for bit:
+// integer arithmetic wraps, REAL arithmetic is IEEE double, and strings
+// end at their first NUL. Anything whose run-time behaviour is undefined
+// or an error (DIV by zero, DIV on REALs, a negative RIGHT length) is left
+// alone for codegen to handle as before.
+class ConstantFolder {
+    ASTContext &Ctx;
+
+public:
+    explicit ConstantFolder(ASTContext &Ctx) : Ctx(Ctx) {}
+
+    // Each returns the folded literal, or null if the operation has to be
+    // evaluated at run time.
+    ExprAST *foldUnary(int Op, ExprAST *Operand);
+    ExprAST *foldBinary(int Op, ExprAST *LHS, ExprAST *RHS);
+    ExprAST *foldCall(SymbolID Callee, llvm::ArrayRef<ExprAST *> Args);
+};
+
+} // namespace cps
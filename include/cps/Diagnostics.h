@@ -0,0 +1,29 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace cps {
+
+// Counts the errors of one compile and hands each to a handler as soon as
+// it is reported, formatted as "Error: <text>\n". Without a handler they go
+// to stderr. The lexer reports from several threads, so error() may be
+// called concurrently; the handler is never entered by two at once.
+class DiagnosticEngine {
+public:
+    using Handler = std::function<void(const std::string &Message)>;
+
+private:
+    Handler OnError;
+    std::mutex Lock;
+    std::atomic<unsigned> NumErrors{0};
+
+public:
+    explicit DiagnosticEngine(Handler H = nullptr) : OnError(std::move(H)) {}
+
+    void error(const char *Fmt, ...) __attribute__((format(printf, 2, 3)));
+    unsigned getNumErrors() const { return NumErrors; }
+};
+
+} // namespace cps
@@ -1,77 +1,82 @@
 #pragma once
 #include "cps/AST.h"
-#include <vector>
-#include <string>
-#include <memory>
 #include <tuple>
 
 namespace cps {
 
 class PrototypeAST {
-    std::string Name;
-    std::vector<std::tuple<std::string, std::string, bool>> Args;
-    std::string ReturnType;
+    SymbolID Name;
+    llvm::ArrayRef<std::tuple<SymbolID, llvm::StringRef, bool>> Args;
+    llvm::StringRef ReturnType;
     bool IsExternal;
 
 public:
-    PrototypeAST(const std::string &Name, 
-                 std::vector<std::tuple<std::string, std::string, bool>> Args, 
-                 const std::string &ReturnType,
+    PrototypeAST(SymbolID Name, 
+                 llvm::ArrayRef<std::tuple<SymbolID, llvm::StringRef, bool>> Args, 
+                 llvm::StringRef ReturnType,
                  bool IsExternal = false)
-        : Name(Name), Args(std::move(Args)), ReturnType(ReturnType), IsExternal(IsExternal) {}
+        : Name(Name), Args(Args), ReturnType(ReturnType), IsExternal(IsExternal) {}
 
-    const std::string &getName() const { return Name; }
-    const std::vector<std::tuple<std::string, std::string, bool>> &getArgs() const { return Args; }
-    const std::string &getReturnType() const { return ReturnType; }
+    SymbolID getNameID() const { return Name; }
+    llvm::ArrayRef<std::tuple<SymbolID, llvm::StringRef, bool>> getArgs() const { return Args; }
+    llvm::StringRef getReturnType() const { return ReturnType; }
     bool isExternal() const { return IsExternal; }
 };
 
 class FunctionDefAST : public StmtAST {
-    std::unique_ptr<PrototypeAST> Proto;
-    std::vector<std::unique_ptr<StmtAST>> Body;
+    PrototypeAST *Proto;
+    llvm::ArrayRef<StmtAST *> Body;
 
 public:
-    FunctionDefAST(std::unique_ptr<PrototypeAST> Proto, 
-                   std::vector<std::unique_ptr<StmtAST>> Body)
-        : Proto(std::move(Proto)), Body(std::move(Body)) {}
+    FunctionDefAST(PrototypeAST *Proto, 
+                   llvm::ArrayRef<StmtAST *> Body)
+        : StmtAST(SK_FunctionDef), Proto(Proto), Body(Body) {}
 
-    PrototypeAST *getProto() const { return Proto.get(); }
-    const std::vector<std::unique_ptr<StmtAST>> &getBody() const { return Body; }
+    PrototypeAST *getProto() const { return Proto; }
+    llvm::ArrayRef<StmtAST *> getBody() const { return Body; }
+
+    static bool classof(const StmtAST *S) { return S->getKind() == SK_FunctionDef; }
 };
 
 class CallExprAST : public ExprAST {
-    std::string Callee;
-    std::vector<std::unique_ptr<ExprAST>> Args;
+    SymbolID Callee;
+    llvm::ArrayRef<ExprAST *> Args;
 
 public:
-    CallExprAST(const std::string &Callee, std::vector<std::unique_ptr<ExprAST>> Args)
-        : Callee(Callee), Args(std::move(Args)) {}
+    CallExprAST(SymbolID Callee, llvm::ArrayRef<ExprAST *> Args)
+        : ExprAST(EK_Call), Callee(Callee), Args(Args) {}
+
+    SymbolID getCalleeID() const { return Callee; }
+    llvm::ArrayRef<ExprAST *> getArgs() const { return Args; }
 
-    const std::string &getCallee() const { return Callee; }
-    const std::vector<std::unique_ptr<ExprAST>> &getArgs() const { return Args; }
+    static bool classof(const ExprAST *E) { return E->getKind() == EK_Call; }
 };
 
 class CallStmtAST : public StmtAST {
-    std::string Callee;
-    std::vector<std::unique_ptr<ExprAST>> Args;
+    SymbolID Callee;
+    llvm::ArrayRef<ExprAST *> Args;
 
 public:
-    CallStmtAST(const std::string &Callee, std::vector<std::unique_ptr<ExprAST>> Args)
-        : Callee(Callee), Args(std::move(Args)) {}
+    CallStmtAST(SymbolID Callee, llvm::ArrayRef<ExprAST *> Args)
+        : StmtAST(SK_Call), Callee(Callee), Args(Args) {}
 
-    const std::string &getCallee() const { return Callee; }
-    const std::vector<std::unique_ptr<ExprAST>> &getArgs() const { return Args; }
+    SymbolID getCalleeID() const { return Callee; }
+    llvm::ArrayRef<ExprAST *> getArgs() const { return Args; }
+
+    static bool classof(const StmtAST *S) { return S->getKind() == SK_Call; }
 };
 
 
 class ReturnStmtAST : public StmtAST {
-    std::unique_ptr<ExprAST> RetVal;
+    ExprAST *RetVal;
 
 public:
-    ReturnStmtAST(std::unique_ptr<ExprAST> RetVal = nullptr) 
-        : RetVal(std::move(RetVal)) {}
+    ReturnStmtAST(ExprAST *RetVal = nullptr) 
+        : StmtAST(SK_Return), RetVal(RetVal) {}
         
-    ExprAST *getRetVal() const { return RetVal.get(); }
+    ExprAST *getRetVal() const { return RetVal; }
+
+    static bool classof(const StmtAST *S) { return S->getKind() == SK_Return; }
 };
 
 } // namespace cps
@@ -1,9 +1,11 @@
 #pragma once
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
+#include "cps/Diagnostics.h"
 #include "cps/FunctionAST.h"
+#include "cps/Interner.h"
+#include "cps/TimeReport.h"
 #include "cps/TypeSystem.h"
-#include <map>
 #include <vector>
 #include <functional>
 #include <string>
@@ -16,20 +18,32 @@ class FunctionGen {
     llvm::Module &Module;
     llvm::IRBuilder<> &Builder;
     TypeSystem &Types;
+    const Interner &Names;
+    DiagnosticEngine &Diags;
     
-    std::map<std::string, llvm::Value*> &NamedValues;
-    std::map<std::string, SymbolInfo> &Symbols;
+    SymbolTable &Symbols;
+    TimeReport *Timer = nullptr;
 
-    void createArgumentAllocas(llvm::Function *F, const std::vector<std::tuple<std::string, std::string, bool>> &Args);
+    // Every FUNCTION/PROCEDURE declared so far, indexed by its name's ID.
+    std::vector<llvm::Function*> Functions;
+
+    void createArgumentAllocas(llvm::Function *F, llvm::ArrayRef<std::tuple<SymbolID, llvm::StringRef, bool>> Args);
 
 public:
     FunctionGen(llvm::LLVMContext &C,
                 llvm::Module &M,
                 llvm::IRBuilder<> &B,
                 TypeSystem &TS,
-                std::map<std::string, llvm::Value*> &NV,
-                std::map<std::string, SymbolInfo> &Sym)
-        : Context(C), Module(M), Builder(B), Types(TS), NamedValues(NV), Symbols(Sym) {}
+                const Interner &N,
+                DiagnosticEngine &D,
+                SymbolTable &Sym)
+        : Context(C), Module(M), Builder(B), Types(TS), Names(N), Diags(D), Symbols(Sym) {}
+
+    void setTimeReport(TimeReport *T) { Timer = T; }
+
+    // The callee for Name, or null if it has not been declared yet. Falls
+    // back to the module for names that are not user routines.
+    llvm::Function *getFunction(SymbolID Name) const;
 
     llvm::Type *getLLVMType(const std::string &TypeName);
 
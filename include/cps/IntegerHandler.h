@@ -2,8 +2,9 @@
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
-#include <map>
+#include "cps/Interner.h"
 #include <string>
+#include <vector>
 
 namespace cps {
 
@@ -11,13 +12,11 @@ class IntegerHandler {
     llvm::LLVMContext &Context;
     llvm::IRBuilder<> &Builder;
     llvm::Module &Module;
-    std::map<std::string, llvm::Value*> &NamedValues;
 
 public:
-    IntegerHandler(llvm::LLVMContext &Ctx, llvm::IRBuilder<> &B, llvm::Module &M, std::map<std::string, llvm::Value*> &NV)
-        : Context(Ctx), Builder(B), Module(M), NamedValues(NV) {}
+    IntegerHandler(llvm::LLVMContext &Ctx, llvm::IRBuilder<> &B, llvm::Module &M)
+        : Context(Ctx), Builder(B), Module(M) {}
 
-    void emitDeclare(const std::string &Name);
     llvm::Value *createLiteral(int64_t Val);
 };
 
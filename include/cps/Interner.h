@@ -0,0 +1,45 @@
+#pragma once
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+#include <cstdint>
+#include <vector>
+
+namespace cps {
+
+using SymbolID = uint32_t;
+
+// Builtin routines are interned first, in this order, so their IDs are
+// fixed and codegen can switch on a callee ID instead of comparing names.
+enum BuiltinID : SymbolID {
+    Builtin_LENGTH,
+    Builtin_MID,
+    Builtin_RIGHT,
+    Builtin_LEFT,
+    Builtin_LCASE,
+    Builtin_UCASE,
+    Builtin_ASC,
+    Builtin_CHR,
+    Builtin_IS_NUM,
+    Builtin_NUM_TO_STR,
+    Builtin_STR_TO_NUM,
+    NumBuiltins
+};
+
+// Gives each distinct identifier in a compilation a dense ID, starting at
+// 0, so that symbol tables can be flat vectors indexed by it. Spellings
+// live in the interner's arena and are NUL-terminated, so get(ID).data()
+// can go straight to printf. Owned by the compilation; not thread-safe.
+class Interner {
+    llvm::StringMap<SymbolID, llvm::BumpPtrAllocator> IDs;
+    std::vector<llvm::StringRef> Spellings;
+
+public:
+    Interner();
+
+    SymbolID intern(llvm::StringRef Spelling);
+    llvm::StringRef get(SymbolID ID) const { return Spellings[ID]; }
+    size_t size() const { return Spellings.size(); }
+};
+
+} // namespace cps
@@ -0,0 +1,41 @@
+#pragma once
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace cps {
+
+class JIT {
+    std::unique_ptr<llvm::orc::LLJIT> TheJIT;
+    llvm::orc::LLLazyJIT *LazyJIT = nullptr;
+
+    bool addHostProcessSymbols();
+
+public:
+    // With Lazy set, each function body is compiled on its first call
+    // through ORC's CompileOnDemandLayer instead of all up front.
+    explicit JIT(bool Lazy = false);
+    ~JIT();
+
+    bool isValid() const { return TheJIT != nullptr; }
+    bool isLazy() const { return LazyJIT != nullptr; }
+
+    // Stamps the JIT's triple and data layout on M before it is optimized.
+    void configureModule(llvm::Module &M);
+
+    bool addModule(std::unique_ptr<llvm::Module> M, std::unique_ptr<llvm::LLVMContext> Ctx);
+
+    // Materializes Name (unmangled) and returns its address, or 0 on failure.
+    uint64_t lookupAddress(const std::string &Name);
+
+    llvm::orc::LLJIT &getLLJIT() { return *TheJIT; }
+
+    // Looks up the compiled entry point and calls it. Returns the program's
+    // exit code, or -1 if main could not be materialized.
+    int runMain();
+};
+
+} // namespace cps
@@ -1,6 +1,10 @@
 #pragma once
+#include "cps/Diagnostics.h"
+#include "cps/Interner.h"
 #include <string>
+#include <string_view>
 #include <cstdint>
+#include <vector>
 
 namespace cps {
 
@@ -78,17 +82,70 @@ enum Token {
     tok_byval = -408
 };
 
+// A whole buffer lexed up front, stored as parallel arrays with one entry
+// per token and a final tok_eof. Payloads index the side table for the
+// token's kind (Integers, Reals or Strings); an identifier's payload is its
+// SymbolID and a char literal's is the character itself.
+struct TokenStream {
+    std::vector<int16_t> Kinds;
+    std::vector<uint32_t> Offsets;
+    std::vector<uint32_t> Lines;
+    std::vector<uint32_t> Columns; // 1-based, in bytes
+    std::vector<uint32_t> Payloads;
+
+    std::vector<int64_t> Integers;
+    std::vector<double> Reals;
+    std::vector<std::string_view> Strings; // views into the lexed buffer
+
+    size_t size() const { return Kinds.size(); }
+};
+
+// Scans a caller-owned buffer with a raw pointer. Identifier and string
+// payloads are views into that buffer, so no token allocates; the buffer
+// must outlive every use of IdentifierStr and StringVal. Identifiers are
+// also interned into Names and reported as IdentifierID.
 class Lexer {
     int CurrentLine = 1;
+    Interner &Names;
+    DiagnosticEngine &Diags;
+
+    const char *BufferStart;
+    const char *CurPtr;
+    const char *BufferEnd;
+    const char *LineStart;
+    const char *TokStart;
+
+    void skipLineComment();
+    int lexNumber();
+
 public:
-    std::string IdentifierStr;
-    std::string StringVal;
+    Lexer(std::string_view Src, Interner &Names, DiagnosticEngine &Diags)
+        : Names(Names), Diags(Diags), BufferStart(Src.data()), CurPtr(Src.data()),
+          BufferEnd(Src.data() + Src.size()), LineStart(Src.data()), TokStart(Src.data()) {}
+
+    Interner &getNames() const { return Names; }
+
+    std::string_view IdentifierStr;
+    SymbolID IdentifierID = 0;
+    std::string_view StringVal;
     int64_t NumVal;
     double RealVal;
     char CharVal = '\0';
 
     int gettok();
     int getLine() const { return CurrentLine; }
+    // Where the token last returned by gettok() starts.
+    uint32_t getTokenOffset() const { return static_cast<uint32_t>(TokStart - BufferStart); }
+    uint32_t getColumn() const { return static_cast<uint32_t>(TokStart - LineStart) + 1; }
+
+    // Lexes the rest of the buffer. Offsets are 32-bit, so the buffer must
+    // be smaller than 4 GiB.
+    TokenStream lexAll();
 };
 
+// Lexes all of Src. Buffers of several MiB are split at line boundaries and
+// the pieces lexed on separate threads; the result, SymbolIDs included, is
+// the same as Lexer(Src, Names, Diags).lexAll().
+TokenStream lexBuffer(std::string_view Src, Interner &Names, DiagnosticEngine &Diags);
+
 }
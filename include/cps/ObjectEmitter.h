@@ -0,0 +1,37 @@
+#pragma once
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Target/TargetMachine.h"
+#include <memory>
+#include <string>
+
+namespace cps {
+
+class ObjectEmitter {
+    std::unique_ptr<llvm::TargetMachine> TM;
+    std::string TargetTriple;
+
+public:
+    explicit ObjectEmitter(unsigned OptLevel = 0);
+    ~ObjectEmitter();
+
+    // Registers the native target with LLVM. Safe to call more than once.
+    static void initializeNativeTarget();
+
+    bool isValid() const { return TM != nullptr; }
+    llvm::TargetMachine *getTargetMachine() const { return TM.get(); }
+
+    // Stamps the host triple and data layout on M. Call before optimizing
+    // so that target-aware passes see the real layout.
+    void configureModule(llvm::Module &M);
+
+    bool emitObject(llvm::Module &M, llvm::SmallVectorImpl<char> &Buffer);
+    bool emitObjectFile(llvm::Module &M, const std::string &Path);
+    static bool writeFile(const std::string &Path, llvm::ArrayRef<char> Data);
+    static bool linkExecutable(const std::string &ObjectPath, const std::string &OutputPath);
+    // Partially links Objects into one relocatable object with `cc -r`.
+    static bool combineObjects(llvm::ArrayRef<llvm::SmallVector<char, 0>> Objects, llvm::SmallVectorImpl<char> &Combined);
+};
+
+} // namespace cps
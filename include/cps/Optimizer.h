@@ -0,0 +1,35 @@
+#pragma once
+#include "llvm/IR/Module.h"
+#include "cps/Diagnostics.h"
+#include "cps/TimeReport.h"
+
+namespace llvm {
+class TargetMachine;
+}
+
+namespace cps {
+
+class Optimizer {
+    unsigned OptLevel;
+    DiagnosticEngine &Diags;
+    llvm::TargetMachine *TM;
+    TimeReport *Timer;
+
+public:
+    // TM gives the pipeline the target's cost model. Without one the
+    // vectorizers and unroller see a generic target with no vector
+    // registers and leave loops scalar.
+    // A module that fails verification is reported to Diags.
+    Optimizer(unsigned Level, DiagnosticEngine &Diags, llvm::TargetMachine *TM = nullptr,
+              TimeReport *Timer = nullptr)
+        : OptLevel(Level), Diags(Diags), TM(TM), Timer(Timer) {}
+
+    unsigned getOptLevel() const { return OptLevel; }
+
+    // Runs the new-PassManager default pipeline for OptLevel (-O0 .. -O3).
+    // A module without a triple or data layout gets TM's. Returns false if
+    // the module is broken and was left untouched.
+    bool run(llvm::Module &M);
+};
+
+} // namespace cps
@@ -1,16 +1,21 @@
 #pragma once
 #include "cps/Lexer.h"
 #include "cps/AST.h"
-#include <vector>
-#include <memory>
+#include "cps/ASTContext.h"
+#include "cps/ConstantFolder.h"
+#include "llvm/ADT/SmallVector.h"
 #include <map>
 #include <tuple>
-#include <string>
 
 namespace cps {
 
 class Parser {
-    Lexer &Lex;
+    const TokenStream &Toks;
+    Interner &Names;
+    ASTContext &Ctx;
+    DiagnosticEngine &Diags;
+    ConstantFolder Folder;
+    size_t Pos = 0;
     int CurTok;
     
     std::map<int, int> BinopPrecedence;
@@ -18,35 +23,48 @@ class Parser {
     int getNextToken();
     int GetTokPrecedence();
 
-    std::unique_ptr<ExprAST> ParseExpression();
-    std::unique_ptr<ExprAST> ParseUnary(); 
-    std::unique_ptr<ExprAST> ParsePrimary();
-    std::unique_ptr<ExprAST> ParseBinOpRHS(int ExprPrec, std::unique_ptr<ExprAST> LHS); 
+    // Payloads and location of the current token.
+    SymbolID getIdentifier() const { return Toks.Payloads[Pos]; }
+    int getLine() const { return static_cast<int>(Toks.Lines[Pos]); }
+    int getColumn() const { return static_cast<int>(Toks.Columns[Pos]); }
 
-    std::unique_ptr<ExprAST> ParseNumberExpr();
-    std::unique_ptr<ExprAST> ParseIdentifierExpr();
-    std::unique_ptr<ExprAST> ParseParenExpr();
-    std::string ParseTypeName(bool AllowVoid = false);
+    ExprAST *ParseExpression();
+    ExprAST *ParseUnary(); 
+    ExprAST *ParsePrimary();
+    ExprAST *ParseBinOpRHS(int ExprPrec, ExprAST *LHS); 
+
+    ExprAST *ParseNumberExpr();
+    ExprAST *ParseIdentifierExpr();
+    ExprAST *ParseParenExpr();
+    llvm::StringRef ParseTypeName(bool AllowVoid = false);
     
-    std::unique_ptr<ExprAST> ParseStringBuiltin(const std::string &FuncName);
+    ExprAST *ParseStringBuiltin(SymbolID Callee);
 
-    std::unique_ptr<StmtAST> ParseStatement();
-    std::unique_ptr<StmtAST> ParseIfStmt();
-    std::unique_ptr<StmtAST> ParseWhileStmt();
-    std::unique_ptr<StmtAST> ParseRepeatStmt();
-    std::unique_ptr<StmtAST> ParseForStmt();
+    StmtAST *ParseStatement();
+    StmtAST *ParseIfStmt();
+    StmtAST *ParseWhileStmt();
+    StmtAST *ParseRepeatStmt();
+    StmtAST *ParseForStmt();
     
-    std::unique_ptr<StmtAST> ParseDeclare();
+    StmtAST *ParseDeclare();
 
-    std::unique_ptr<StmtAST> ParseFunction();
-    std::unique_ptr<StmtAST> ParseProcedure();
-    std::unique_ptr<StmtAST> ParseCallStmt();
-    std::unique_ptr<StmtAST> ParseReturnStmt();
-    std::vector<std::tuple<std::string, std::string, bool>> ParsePrototypeArgs();
+    StmtAST *ParseFunction();
+    StmtAST *ParseProcedure();
+    StmtAST *ParseCallStmt();
+    StmtAST *ParseReturnStmt();
+    llvm::SmallVector<std::tuple<SymbolID, llvm::StringRef, bool>, 4> ParsePrototypeArgs();
     
 public:
-    Parser(Lexer &L);
-    std::vector<std::unique_ptr<StmtAST>> Parse();
+    // Toks must end with tok_eof, as Lexer::lexAll() leaves it, and its
+    // identifiers must have been interned into Names. Nodes are allocated
+    // from Ctx, which must outlive every use of the tree. Syntax errors
+    // are reported to Diags.
+    Parser(const TokenStream &Toks, Interner &Names, ASTContext &Ctx, DiagnosticEngine &Diags);
+
+    // Parses the next top-level statement, skipping any that fail to parse,
+    // or returns null at the end of the input. The parser keeps no nodes of
+    // its own, so Ctx may be reset between calls.
+    StmtAST *ParseNext();
 };
 
 } // namespace cps
@@ -0,0 +1,19 @@
+#pragma once
+
+namespace cps {
+
+// Block-at-a-time scanning for the lexer's hot loops. The implementation
+// (AVX2, SSE2 or scalar) is picked once for the running CPU. Each routine
+// scans [P, End) and returns where it stopped, or End.
+
+// Skips isspace() characters, adding the newlines it passes to Lines and
+// pointing LineStart just past the last of them.
+const char *skipWhitespace(const char *P, const char *End, int &Lines, const char *&LineStart);
+
+// Finds the first A or B, e.g. the end of a comment or string literal.
+const char *findEither(const char *P, const char *End, char A, char B);
+
+// "avx2", "sse2" or "scalar".
+const char *getScanImplName();
+
+} // namespace cps
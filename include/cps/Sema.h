@@ -0,0 +1,76 @@
+#pragma once
+#include "cps/AST.h"
+#include "cps/Diagnostics.h"
+#include "cps/FunctionAST.h"
+#include "cps/Interner.h"
+#include "cps/SymbolTable.h"
+#include "cps/TypeSystem.h"
+#include "llvm/ADT/SmallVector.h"
+#include <vector>
+
+namespace cps {
+
+// Resolves names and types between parsing and codegen. Every expression
+// codegen will lower gets its TypeInfo annotated here, and name and type
+// errors are reported before any IR is built; codegen then reads the
+// annotations and silently skips the statements reported here.
+//
+// Scoping follows codegen exactly: one flat scope per FUNCTION/PROCEDURE,
+// while array shapes stay visible program-wide, and a subtree codegen
+// would abandon after an error is not visited either.
+class Sema {
+    struct Symbol {
+        const TypeInfo *Type = nullptr; // null for a parameter of unknown type
+        bool IsArray = false;
+    };
+
+    struct FunctionInfo {
+        const TypeInfo *ReturnType = nullptr; // null until declared
+        bool Defined = false;
+        // Which parameters are passed as pointers (BYREF or STRING).
+        llvm::SmallVector<bool, 4> PointerParams;
+    };
+
+    const Interner &Names;
+    const TypeSystem &Types;
+    DiagnosticEngine &Diags;
+    const TypeInfo *IntegerType;
+    const TypeInfo *RealType;
+    const TypeInfo *BooleanType;
+    const TypeInfo *CharType;
+    const TypeInfo *StringType;
+
+    ScopedSymbolTable<Symbol> Symbols;
+    // Indexed by SymbolID and grown lazily to Names.size().
+    std::vector<unsigned> ArrayRanks; // 0 for a name that is not an array
+    std::vector<FunctionInfo> Functions;
+
+    FunctionInfo &getFunction(SymbolID Name);
+    unsigned getArrayRank(SymbolID Name) const;
+
+    // Each returns false where codegen would fail to produce a value.
+    bool checkExpr(ExprAST *Expr);
+    bool checkCall(CallExprAST *Call);
+    bool checkCallArgs(SymbolID Callee, llvm::ArrayRef<ExprAST *> Args);
+    bool checkIndices(llvm::ArrayRef<ExprAST *> Indices);
+
+    void checkStmt(StmtAST *Stmt);
+    void checkBody(llvm::ArrayRef<StmtAST *> Body);
+    void checkArrayDeclare(ArrayDeclareStmtAST *Stmt);
+    void checkArrayAssign(ArrayAssignStmtAST *Stmt);
+    void checkOutput(OutputStmtAST *Stmt);
+    void checkFor(ForStmtAST *Stmt);
+    void checkFunctionDef(FunctionDefAST *Def);
+
+public:
+    // Names must be the interner the AST was parsed with, and Types the
+    // type system codegen will use, so annotations can be compared by
+    // pointer. Errors are reported to Diags.
+    Sema(const Interner &Names, const TypeSystem &Types, DiagnosticEngine &Diags);
+
+    // Checks one top-level statement. Statements must be passed in source
+    // order; nothing is kept that refers to one after this returns.
+    void check(StmtAST *Stmt);
+};
+
+} // namespace cps
@@ -2,6 +2,7 @@
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
+#include "cps/StringHandler.h"
 
 namespace cps {
 
@@ -9,14 +10,14 @@ class StringConversionHandler {
     llvm::LLVMContext &Context;
     llvm::IRBuilder<> &Builder;
     llvm::Module &Module;
+    StringHandler &Strings;
 
     llvm::FunctionCallee SprintfFunc;
     llvm::FunctionCallee StrtolFunc;
     llvm::FunctionCallee StrtodFunc;
-    llvm::FunctionCallee MallocFunc;
 
 public:
-    StringConversionHandler(llvm::LLVMContext &Ctx, llvm::IRBuilder<> &B, llvm::Module &M);
+    StringConversionHandler(llvm::LLVMContext &Ctx, llvm::IRBuilder<> &B, llvm::Module &M, StringHandler &S);
     
     void setupExternalFunctions();
     
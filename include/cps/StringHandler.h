@@ -2,16 +2,21 @@
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
-#include <map>
+#include "cps/Interner.h"
 #include <string>
+#include <vector>
 
 namespace cps {
 
+// A STRING value is a pointer to NUL-terminated characters preceded by
+// their length as an i64. LENGTH is a load instead of a strlen, substrings
+// and concatenation copy known sizes, and the pointer can still be handed
+// to printf, scanf or strtod as a C string. Every string codegen creates,
+// literals included, must be made by createLiteral() or allocString().
 class StringHandler {
     llvm::LLVMContext &Context;
     llvm::IRBuilder<> &Builder;
     llvm::Module &Module;
-    std::map<std::string, llvm::Value*> &NamedValues;
 
     llvm::FunctionCallee MallocFunc;
     llvm::FunctionCallee FreeFunc;
@@ -20,15 +25,37 @@ class StringHandler {
     llvm::FunctionCallee ToUpperFunc;
     llvm::FunctionCallee ToLowerFunc;
 
+    llvm::Value *getLengthPtr(llvm::Value *Str);
+    llvm::Value *allocBuffer(llvm::Value *Capacity, const llvm::Twine &Name);
+    llvm::Value *emitCaseMap(llvm::Value *Str, llvm::FunctionCallee MapFunc, const llvm::Twine &Name);
+
 public:
-    StringHandler(llvm::LLVMContext &Ctx, llvm::IRBuilder<> &B, llvm::Module &M, 
-                  std::map<std::string, llvm::Value*> &NV);
+    StringHandler(llvm::LLVMContext &Ctx, llvm::IRBuilder<> &B, llvm::Module &M);
     
     void setupExternalFunctions();
-    void emitDeclare(const std::string &Name);
-    llvm::Value *createLiteral(const std::string &Val);
-    
+    llvm::Value *createLiteral(llvm::StringRef Val, const llvm::Twine &Name = "str");
+
+    // Allocates a string of Len characters, NUL-terminated and with its
+    // length set; the caller fills in the characters.
+    llvm::Value *allocString(llvm::Value *Len, const llvm::Twine &Name = "");
+    // Overwrites the length of a string whose characters were written by C
+    // code that reported how many it wrote.
+    void storeLength(llvm::Value *Str, llvm::Value *Len);
+    // Sets the length of a string whose characters were written by C code
+    // that did not say how many, such as scanf.
+    void adoptCString(llvm::Value *Str);
+
     llvm::Value *emitLength(llvm::Value *Str);
+    llvm::Value *emitConcat(llvm::Value *LHS, llvm::Value *RHS);
+    // Lowers `s <- s & a & b ...` for a variable whose value is Str. While
+    // the variable owns its buffer (Capacity holds a non-zero size) the
+    // parts are copied in place; otherwise, or once the buffer is full, the
+    // string moves to a new buffer twice the needed size, so a loop of
+    // appends costs amortized O(1) per character. None of Parts may be the
+    // variable's own buffer.
+    void emitAppend(llvm::Value *Storage, llvm::Value *Capacity, llvm::Value *Str,
+                    llvm::ArrayRef<llvm::Value *> Parts);
+    llvm::Value *emitFromChar(llvm::Value *Char);
     llvm::Value *emitMid(llvm::Value *Str, llvm::Value *Start, llvm::Value *Len);
     llvm::Value *emitRight(llvm::Value *Str, llvm::Value *Len);
     llvm::Value *emitLeft(llvm::Value *Str, llvm::Value *Len);
@@ -0,0 +1,71 @@
+#pragma once
+#include "cps/Interner.h"
+#include <utility>
+#include <vector>
+
+namespace cps {
+
+// Maps each SymbolID to what the scope being compiled knows about it.
+// Entries live in one flat vector indexed by SymbolID. Declaring a name
+// inside a scope logs the entry it replaces, and leaving the scope replays
+// that log, so entering and leaving a scope cost O(names it declared)
+// rather than O(names in the program).
+//
+// A FUNCTION/PROCEDURE body cannot see the program's variables, so its
+// scope is opaque: entries are tagged with the function nesting depth
+// they were declared at and only those at the current depth are visible.
+// A block scope merely shadows the names it redeclares.
+template <typename T>
+class ScopedSymbolTable {
+    struct Entry {
+        T Value{};
+        unsigned Depth = 0;
+        bool Declared = false;
+    };
+
+    struct Scope {
+        size_t UndoStart;
+        bool Opaque;
+    };
+
+    const Interner &Names;
+    std::vector<Entry> Entries;
+    std::vector<std::pair<SymbolID, Entry>> UndoLog;
+    std::vector<Scope> Scopes;
+    unsigned Depth = 0;
+
+public:
+    explicit ScopedSymbolTable(const Interner &Names) : Names(Names) {}
+
+    void enterFunctionScope() {
+        Scopes.push_back({UndoLog.size(), true});
+        ++Depth;
+    }
+
+    void enterBlockScope() { Scopes.push_back({UndoLog.size(), false}); }
+
+    void leaveScope() {
+        Scope S = Scopes.back();
+        Scopes.pop_back();
+        while (UndoLog.size() > S.UndoStart) {
+            Entries[UndoLog.back().first] = std::move(UndoLog.back().second);
+            UndoLog.pop_back();
+        }
+        if (S.Opaque) --Depth;
+    }
+
+    // Null if Name is not declared in the current function.
+    const T *lookup(SymbolID Name) const {
+        if (Name >= Entries.size()) return nullptr;
+        const Entry &E = Entries[Name];
+        return E.Declared && E.Depth == Depth ? &E.Value : nullptr;
+    }
+
+    void declare(SymbolID Name, T Value) {
+        if (Entries.size() <= Name) Entries.resize(Names.size());
+        if (!Scopes.empty()) UndoLog.emplace_back(Name, std::move(Entries[Name]));
+        Entries[Name] = {std::move(Value), Depth, true};
+    }
+};
+
+} // namespace cps
@@ -0,0 +1,70 @@
+#pragma once
+#include "cps/JIT.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Target/TargetMachine.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cps {
+
+// Two-tier execution: every function is first compiled at -O0 with a call
+// counter in its prologue. User functions are always called through an ORC
+// indirection stub; once a function's counter reaches the threshold it is
+// recompiled at -O2 on a background thread and its stub is repointed.
+class TieredJIT {
+    JIT BaseJIT;
+    std::unique_ptr<llvm::orc::IndirectStubsManager> Stubs;
+
+    uint64_t Threshold;
+    unsigned HotOptLevel = 2;
+    // Host target the tier-2 pipeline costs against. Only the worker
+    // thread uses it.
+    std::unique_ptr<llvm::TargetMachine> HostTM;
+
+    // Bitcode of the module before tier-0 instrumentation; every hot
+    // function is recompiled from a fresh parse of it.
+    llvm::SmallVector<char, 0> PristineBitcode;
+    std::vector<std::string> TieredNames;
+    std::unique_ptr<std::atomic<bool>[]> Promoted;
+
+    std::mutex QueueMutex;
+    std::condition_variable QueueCV;
+    std::deque<uint64_t> Queue;
+    bool Stopping = false;
+    std::thread Worker;
+
+    std::atomic<unsigned> NumPromoted{0};
+
+    bool instrumentTier0(llvm::Module &M);
+    bool createStubs();
+    void workerLoop();
+    bool promote(uint64_t Id);
+
+public:
+    explicit TieredJIT(uint64_t Threshold);
+    ~TieredJIT();
+
+    bool isValid() const { return BaseJIT.isValid() && HostTM != nullptr; }
+
+    void configureModule(llvm::Module &M) { BaseJIT.configureModule(M); }
+
+    bool addModule(std::unique_ptr<llvm::Module> M, std::unique_ptr<llvm::LLVMContext> Ctx);
+    int runMain();
+
+    unsigned getNumPromoted() const { return NumPromoted; }
+
+    // Called from tier-0 code when a counter reaches the threshold.
+    void requestPromotion(uint64_t Id);
+};
+
+} // namespace cps
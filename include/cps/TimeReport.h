@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace cps {
+
+// Collects wall time, CPU time and peak RSS per compiler phase for
+// -ftime-report. Phases are listed in the order they were first entered.
+// Times are exclusive: a phase nested inside another (lexing inside parsing,
+// a FUNCTION's codegen inside the main program's) is not counted twice.
+// Not thread-safe; use one report per compiling thread.
+class TimeReport {
+public:
+    struct Phase {
+        std::string Name;
+        double WallSeconds = 0;
+        double CPUSeconds = 0;
+        uint64_t PeakRSSKB = 0; // process high-water mark when the phase last ended
+        uint64_t Count = 0;
+    };
+
+    // Times one run of a phase. A null report makes the scope a no-op, so
+    // call sites do not need to check whether timing was requested.
+    class Scope {
+        TimeReport *Report;
+        size_t Index = 0;
+        double StartWall = 0;
+        double StartCPU = 0;
+        double ChildWall = 0;
+        double ChildCPU = 0;
+        Scope *Parent = nullptr;
+
+    public:
+        Scope(TimeReport *Report, size_t Index);
+        Scope(TimeReport *Report, const std::string &Name);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+    };
+
+    // Returns a stable index for Name, creating the phase on first use.
+    // Hot call sites look the index up once and time with it afterwards.
+    size_t getPhase(const std::string &Name);
+
+    const std::vector<Phase> &getPhases() const { return Phases; }
+
+    void print(FILE *Out) const;
+    void printJSON(FILE *Out) const;
+
+private:
+    std::vector<Phase> Phases;
+    std::map<std::string, size_t> PhaseIndex;
+    Scope *Active = nullptr;
+};
+
+} // namespace cps
@@ -3,6 +3,7 @@
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Type.h"
+#include "cps/SymbolTable.h"
 #include <cstdint>
 #include <map>
 #include <string>
@@ -39,10 +40,15 @@ struct TypeInfo {
 
 struct SymbolInfo {
     llvm::Value *Storage = nullptr;
-    std::string TypeName;
+    const TypeInfo *Type = nullptr; // null for a parameter of unknown type
     bool IsArray = false;
+    // STRING variables: an i64 slot holding the capacity of the buffer the
+    // variable owns, or 0 if its value may be shared. See emitAppend().
+    llvm::Value *Capacity = nullptr;
 };
 
+using SymbolTable = ScopedSymbolTable<SymbolInfo>;
+
 class TypeSystem {
     llvm::LLVMContext &Context;
     std::map<std::string, TypeInfo> Types;
@@ -0,0 +1,139 @@
+#include "cps/BatchCompiler.h"
+#include "cps/Compiler.h"
+#include "cps/ObjectEmitter.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <thread>
+
+using namespace cps;
+
+BatchCompiler::BatchCompiler(unsigned OptLevel, unsigned NumWorkers, std::string OutputDir)
+    : OptLevel(OptLevel), NumWorkers(NumWorkers ? NumWorkers : 1), OutputDir(std::move(OutputDir)) {}
+
+std::string BatchCompiler::getOutputPath(const std::string &InputPath) const {
+    llvm::SmallString<128> Path;
+    if (OutputDir.empty()) {
+        Path = InputPath;
+    } else {
+        Path = OutputDir;
+        llvm::sys::path::append(Path, llvm::sys::path::filename(InputPath));
+    }
+    llvm::sys::path::replace_extension(Path, "o");
+    return Path.str().str();
+}
+
+bool BatchCompiler::readManifest(const std::string &Path, std::vector<std::string> &Inputs) {
+    auto Buffer = llvm::MemoryBuffer::getFile(Path);
+    if (!Buffer) {
+        fprintf(stderr, "Error: Cannot read manifest %s: %s\n", Path.c_str(), Buffer.getError().message().c_str());
+        return false;
+    }
+
+    llvm::SmallVector<llvm::StringRef, 0> Lines;
+    (*Buffer)->getBuffer().split(Lines, '\n', -1, false);
+    for (llvm::StringRef Line : Lines) {
+        Line = Line.trim();
+        if (!Line.empty()) Inputs.push_back(Line.str());
+    }
+    return true;
+}
+
+BatchResult BatchCompiler::compileFile(ObjectEmitter &Emitter, const std::string &InputPath) const {
+    auto Start = std::chrono::steady_clock::now();
+    BatchResult Result;
+    Result.InputPath = InputPath;
+    Result.OutputPath = getOutputPath(InputPath);
+
+    auto Buffer = llvm::MemoryBuffer::getFile(InputPath);
+    if (!Buffer) {
+        fprintf(stderr, "Error: Cannot read %s: %s\n", InputPath.c_str(), Buffer.getError().message().c_str());
+    } else {
+        CompileOptions Opts;
+        Opts.OptLevel = OptLevel;
+        Opts.Output = CompileOutput::Object;
+        Opts.Emitter = &Emitter;
+        // Workers print concurrently, so say which input each error is for.
+        Opts.OnError = [&InputPath](const std::string &Message) {
+            fprintf(stderr, "%s: %s", InputPath.c_str(), Message.c_str());
+        };
+
+        llvm::StringRef Source = (*Buffer)->getBuffer();
+        CompileResult Compiled = compile(std::string_view(Source.data(), Source.size()), Opts);
+        Result.NumErrors = Compiled.NumErrors;
+        Result.Ok = Compiled.Ok && Compiled.NumErrors == 0 &&
+                    ObjectEmitter::writeFile(Result.OutputPath, Compiled.Object);
+    }
+
+    Result.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+    return Result;
+}
+
+std::vector<BatchResult> BatchCompiler::run(const std::vector<std::string> &Inputs) const {
+    std::vector<BatchResult> Results(Inputs.size());
+    if (!OutputDir.empty()) {
+        if (std::error_code EC = llvm::sys::fs::create_directories(OutputDir)) {
+            fprintf(stderr, "Error: Cannot create %s: %s\n", OutputDir.c_str(), EC.message().c_str());
+            for (size_t i = 0; i < Inputs.size(); ++i) Results[i].InputPath = Inputs[i];
+            return Results;
+        }
+    }
+
+    // With -o DIR, a/x.txt and b/x.txt both map to DIR/x.o; compiling both
+    // would let one silently overwrite the other.
+    std::vector<char> Clashes(Inputs.size(), false);
+    std::map<std::string, size_t> FirstWriter;
+    for (size_t i = 0; i < Inputs.size(); ++i) {
+        llvm::SmallString<128> Output(getOutputPath(Inputs[i]));
+        llvm::sys::path::remove_dots(Output, true);
+        auto Inserted = FirstWriter.emplace(Output.str().str(), i);
+        if (Inserted.second) continue;
+        size_t First = Inserted.first->second;
+        fprintf(stderr, "Error: %s and %s would both be compiled to %s\n",
+                Inputs[First].c_str(), Inputs[i].c_str(), Output.c_str());
+        Clashes[First] = Clashes[i] = true;
+    }
+
+    std::atomic<size_t> Next(0);
+
+    auto Worker = [&] {
+        // One TargetMachine per thread; they are not safe to share.
+        ObjectEmitter Emitter(OptLevel);
+        for (size_t i = Next++; i < Inputs.size(); i = Next++) {
+            if (!Emitter.isValid() || Clashes[i]) {
+                Results[i].InputPath = Inputs[i];
+                Results[i].OutputPath = getOutputPath(Inputs[i]);
+                continue;
+            }
+            Results[i] = compileFile(Emitter, Inputs[i]);
+        }
+    };
+
+    ObjectEmitter::initializeNativeTarget();
+    unsigned Count = static_cast<unsigned>(std::min<size_t>(NumWorkers, Inputs.size()));
+    std::vector<std::thread> Threads;
+    for (unsigned i = 1; i < Count; ++i) Threads.emplace_back(Worker);
+    Worker();
+    for (auto &T : Threads) T.join();
+    return Results;
+}
+
+void BatchCompiler::printSummary(const std::vector<BatchResult> &Results, double WallSeconds, FILE *Out) {
+    double TotalSeconds = 0;
+    size_t Failed = 0;
+    for (const BatchResult &R : Results) {
+        fprintf(Out, "%10.2f ms  %-4s %s", R.Seconds * 1000, R.Ok ? "ok" : "FAIL", R.InputPath.c_str());
+        if (R.NumErrors) fprintf(Out, " (%u error%s)", R.NumErrors, R.NumErrors == 1 ? "" : "s");
+        fputc('\n', Out);
+        TotalSeconds += R.Seconds;
+        if (!R.Ok) ++Failed;
+    }
+    fprintf(Out, "%zu files, %zu failed, %.3f s wall, %.3f s compile time\n",
+            Results.size(), Failed, WallSeconds, TotalSeconds);
+}
@@ -0,0 +1,224 @@
+#include "cps/CompileCache.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA256.h"
+#include "llvm/Support/raw_ostream.h"
+#if LLVM_VERSION_MAJOR >= 17
+#include "llvm/TargetParser/Host.h"
+#else
+#include "llvm/Support/Host.h"
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#ifndef CPS_VERSION
+#define CPS_VERSION "unknown"
+#endif
+
+using namespace llvm;
+using namespace cps;
+
+CompileCache::CompileCache(std::string Dir, uint64_t MaxBytes)
+    : Dir(std::move(Dir)), MaxBytes(MaxBytes) {
+    if (std::error_code EC = sys::fs::create_directories(this->Dir)) {
+        fprintf(stderr, "Error: Cannot create cache directory %s: %s\n",
+                this->Dir.c_str(), EC.message().c_str());
+        return;
+    }
+    Valid = true;
+}
+
+std::string CompileCache::getDefaultDir() {
+    SmallString<128> Path;
+    if (!sys::path::cache_directory(Path)) {
+        sys::fs::current_path(Path);
+    }
+    sys::path::append(Path, "cpsc");
+    return Path.str().str();
+}
+
+// Identifies this build of the compiler. CPS_VERSION does not change when
+// codegen does, so the running executable's path, size and modification
+// time go into every key: any rebuild invalidates the cache. Hashing the
+// binary itself would cost more than most hits save.
+static const std::string &getBuildID() {
+    static const std::string ID = [] {
+        std::string Path = sys::fs::getMainExecutable(nullptr, reinterpret_cast<void *>(&getBuildID));
+        sys::fs::file_status Status;
+        if (Path.empty() || sys::fs::status(Path, Status)) return std::string("unknown");
+        return Path + ' ' + std::to_string(Status.getSize()) + ' ' +
+               std::to_string(Status.getLastModificationTime().time_since_epoch().count());
+    }();
+    return ID;
+}
+
+std::string CompileCache::computeKey(StringRef Source, StringRef Flags) {
+    std::string Material;
+    raw_string_ostream OS(Material);
+    OS << "cpsc " << CPS_VERSION << '\0'
+       << getBuildID() << '\0'
+       << "llvm " << LLVM_VERSION_STRING << '\0'
+       << sys::getDefaultTargetTriple() << '\0'
+       << sys::getHostCPUName() << '\0'
+       << Flags << '\0'
+       << Source;
+    OS.flush();
+
+    auto Digest = SHA256::hash(arrayRefFromStringRef(Material));
+    return toHex(Digest, true);
+}
+
+std::string CompileCache::getEntryPath(const std::string &Key, CacheEntryKind Kind) const {
+    SmallString<128> Path(Dir);
+    sys::path::append(Path, Key + (Kind == CacheEntryKind::Object ? ".o" : ".bc"));
+    return Path.str().str();
+}
+
+std::string CompileCache::getStatsPath() const {
+    SmallString<128> Path(Dir);
+    sys::path::append(Path, "stats");
+    return Path.str().str();
+}
+
+bool CompileCache::writeAtomically(const std::string &Path, ArrayRef<char> Data) const {
+    SmallString<128> TempModel(Dir);
+    sys::path::append(TempModel, "tmp-%%%%%%%%.part");
+
+    int FD;
+    SmallString<128> TempPath;
+    if (sys::fs::createUniqueFile(TempModel, FD, TempPath)) return false;
+
+    {
+        raw_fd_ostream OS(FD, /*shouldClose=*/true);
+        OS.write(Data.data(), Data.size());
+        OS.close();
+        if (OS.has_error()) {
+            OS.clear_error();
+            sys::fs::remove(TempPath);
+            return false;
+        }
+    }
+
+    if (sys::fs::rename(TempPath, Path)) {
+        sys::fs::remove(TempPath);
+        return false;
+    }
+    return true;
+}
+
+bool CompileCache::lookup(const std::string &Key, CacheEntryKind Kind, SmallVectorImpl<char> &Data) const {
+    if (!Valid) return false;
+
+    std::string Path = getEntryPath(Key, Kind);
+    auto Buffer = MemoryBuffer::getFile(Path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if (!Buffer) {
+        updateStats(0, 1, 0);
+        return false;
+    }
+
+    Data.assign((*Buffer)->getBufferStart(), (*Buffer)->getBufferEnd());
+
+    int FD;
+    if (!sys::fs::openFileForRead(Path, FD)) {
+        sys::fs::setLastAccessAndModificationTime(FD, std::chrono::system_clock::now());
+        sys::fs::closeFile(FD);
+    }
+
+    updateStats(1, 0, 0);
+    return true;
+}
+
+bool CompileCache::store(const std::string &Key, CacheEntryKind Kind, ArrayRef<char> Data) const {
+    if (!Valid) return false;
+    if (!writeAtomically(getEntryPath(Key, Kind), Data)) {
+        fprintf(stderr, "Error: Cannot write cache entry in %s\n", Dir.c_str());
+        return false;
+    }
+
+    uint64_t Evicted = evictToLimit();
+    if (Evicted) updateStats(0, 0, Evicted);
+    return true;
+}
+
+uint64_t CompileCache::evictToLimit() const {
+    struct Entry {
+        std::string Path;
+        uint64_t Size;
+        sys::TimePoint<> LastUsed;
+    };
+
+    std::vector<Entry> Entries;
+    uint64_t TotalBytes = 0;
+
+    // A writer that died between creating its temp file and renaming it
+    // leaves the file behind. No live write takes anywhere near this long.
+    auto StaleBefore = std::chrono::system_clock::now() - std::chrono::hours(1);
+
+    std::error_code EC;
+    for (sys::fs::directory_iterator It(Dir, EC), End; It != End && !EC; It.increment(EC)) {
+        StringRef Ext = sys::path::extension(It->path());
+        if (Ext != ".o" && Ext != ".bc" && Ext != ".part") continue;
+
+        sys::fs::file_status Status;
+        if (sys::fs::status(It->path(), Status)) continue;
+        if (Ext == ".part") {
+            if (Status.getLastModificationTime() < StaleBefore) sys::fs::remove(It->path());
+            continue;
+        }
+        Entries.push_back({It->path(), Status.getSize(), Status.getLastModificationTime()});
+        TotalBytes += Status.getSize();
+    }
+
+    if (TotalBytes <= MaxBytes) return 0;
+
+    std::sort(Entries.begin(), Entries.end(), [](const Entry &A, const Entry &B) {
+        return A.LastUsed < B.LastUsed;
+    });
+
+    uint64_t Evicted = 0;
+    for (const auto &E : Entries) {
+        if (TotalBytes <= MaxBytes) break;
+        if (!sys::fs::remove(E.Path)) {
+            TotalBytes -= E.Size;
+            ++Evicted;
+        }
+    }
+    return Evicted;
+}
+
+CacheStats CompileCache::loadStats() const {
+    CacheStats Stats;
+    auto Buffer = MemoryBuffer::getFile(getStatsPath());
+    if (!Buffer) return Stats;
+
+    unsigned long long Hits = 0, Misses = 0, Evictions = 0;
+    std::string Text = (*Buffer)->getBuffer().str();
+    if (sscanf(Text.c_str(), "hits %llu misses %llu evictions %llu", &Hits, &Misses, &Evictions) == 3) {
+        Stats.Hits = Hits;
+        Stats.Misses = Misses;
+        Stats.Evictions = Evictions;
+    }
+    return Stats;
+}
+
+void CompileCache::updateStats(uint64_t Hits, uint64_t Misses, uint64_t Evictions) const {
+    // Read-modify-write without a lock: concurrent compilers may lose an
+    // increment, but the file itself is always replaced atomically.
+    CacheStats Stats = loadStats();
+    Stats.Hits += Hits;
+    Stats.Misses += Misses;
+    Stats.Evictions += Evictions;
+
+    std::string Text;
+    raw_string_ostream OS(Text);
+    OS << "hits " << Stats.Hits << "\nmisses " << Stats.Misses << "\nevictions " << Stats.Evictions << "\n";
+    OS.flush();
+    writeAtomically(getStatsPath(), ArrayRef<char>(Text.data(), Text.size()));
+}
@@ -12,15 +12,15 @@ using namespace cps;
 ArrayHandler::ArrayHandler(LLVMContext &C,
                            IRBuilder<> &B,
                            Module &M,
-                           std::map<std::string, Value*> &NV,
-                           std::map<std::string, SymbolInfo> &Sym,
+                           const Interner &N,
+                           const SymbolTable &Sym,
                            TypeSystem &TS,
                            RuntimeCheck &RC)
     : TheContext(&C),
       Builder(&B),
       TheModule(&M),
-      NamedValues(&NV),
-      Symbols(&Sym),
+      Names(N),
+      Symbols(Sym),
       Types(TS),
       RuntimeChecker(RC) {
     setupExternalFunctions();
@@ -39,15 +39,14 @@ void ArrayHandler::setupExternalFunctions() {
     FreeFunc = TheModule->getOrInsertFunction("free", FreeType);
 }
 
-const ArrayMetadata *ArrayHandler::getMetadata(const std::string &Name) const {
-    auto It = ArrayTable.find(Name);
-    if (It == ArrayTable.end()) {
+const ArrayMetadata *ArrayHandler::getMetadata(SymbolID Name) const {
+    if (Name >= ArrayTable.size() || ArrayTable[Name].Rank == 0) {
         return nullptr;
     }
-    return &It->second;
+    return &ArrayTable[Name];
 }
 
-Value *ArrayHandler::computeFlatIndex(const std::string &Name, const std::vector<Value*> &Indices) {
+Value *ArrayHandler::computeFlatIndex(SymbolID Name, const std::vector<Value*> &Indices) {
     const ArrayMetadata *Meta = getMetadata(Name);
     if (!Meta) return nullptr;
 
@@ -62,35 +61,32 @@ Value *ArrayHandler::computeFlatIndex(const std::string &Name, const std::vector
     return Offset;
 }
 
-Value *ArrayHandler::getArrayBasePointer(const std::string &Name) {
-    auto It = NamedValues->find(Name);
-    if (It == NamedValues->end() || !It->second) {
-        return nullptr;
-    }
-    return Builder->CreateLoad(PointerType::getUnqual(*TheContext), It->second, (Name + "_raw").c_str());
+Value *ArrayHandler::getArrayBasePointer(SymbolID Name) {
+    const SymbolInfo *Info = Symbols.lookup(Name);
+    if (!Info) return nullptr;
+    return Builder->CreateLoad(PointerType::getUnqual(*TheContext), Info->Storage, Names.get(Name) + "_raw");
 }
 
-Value *ArrayHandler::getElementPointer(const std::string &Name, Value *Offset) {
-    const ArrayMetadata *Meta = getMetadata(Name);
+Value *ArrayHandler::getElementPointer(SymbolID ID, Value *Offset) {
+    const ArrayMetadata *Meta = getMetadata(ID);
     if (!Meta || !Offset) return nullptr;
 
-    Value *RawPtr = getArrayBasePointer(Name);
+    Value *RawPtr = getArrayBasePointer(ID);
     if (!RawPtr) return nullptr;
 
+    StringRef Name = Names.get(ID);
     PointerType *TypedPtrTy = PointerType::getUnqual(Meta->ElementType);
     Value *TypedPtr = Builder->CreateBitCast(RawPtr, TypedPtrTy, Name + "_typed_ptr");
     return Builder->CreateGEP(Meta->ElementType, TypedPtr, Offset, Name + "_elem_ptr");
 }
 
 void ArrayHandler::emitArrayDeclare(ArrayDeclareStmtAST *Stmt, CodeGen &CG) {
-    std::string Name = Stmt->getName();
+    SymbolID ID = Stmt->getNameID();
+    StringRef Name = Names.get(ID);
     int Rank = static_cast<int>(Stmt->getBounds().size());
 
-    const TypeInfo *ElemInfo = Types.resolve(Stmt->getType());
-    if (!ElemInfo || !ElemInfo->LLVMType || ElemInfo->isVoid()) {
-        fprintf(stderr, "Error: Unknown array element type %s\n", Stmt->getType().c_str());
-        return;
-    }
+    const TypeInfo *ElemInfo = Types.resolve(Stmt->getType().str());
+    if (!ElemInfo || !ElemInfo->LLVMType || ElemInfo->isVoid()) return;
 
     std::vector<Value*> Lows;
     std::vector<Value*> Highs;
@@ -98,8 +94,8 @@ void ArrayHandler::emitArrayDeclare(ArrayDeclareStmtAST *Stmt, CodeGen &CG) {
     Value *TotalElements = ConstantInt::get(*TheContext, APInt(64, 1));
 
     for (const auto &Pair : Stmt->getBounds()) {
-        Value *L = CG.emitExpr(Pair.first.get());
-        Value *R = CG.emitExpr(Pair.second.get());
+        Value *L = CG.emitExpr(Pair.first);
+        Value *R = CG.emitExpr(Pair.second);
         L = CG.coerceValueToType(L, CG.resolveType("INTEGER"));
         R = CG.coerceValueToType(R, CG.resolveType("INTEGER"));
 
@@ -128,7 +124,8 @@ void ArrayHandler::emitArrayDeclare(ArrayDeclareStmtAST *Stmt, CodeGen &CG) {
     Meta.LowerBounds = std::move(Lows);
     Meta.UpperBounds = std::move(Highs);
     Meta.Multipliers = std::move(Multipliers);
-    ArrayTable[Name] = Meta;
+    if (ArrayTable.size() <= ID) ArrayTable.resize(Names.size());
+    ArrayTable[ID] = std::move(Meta);
 
     Value *ElemSize = ConstantInt::get(*TheContext, APInt(64, ElemInfo->ElementSize));
     Value *TotalBytes = Builder->CreateMul(TotalElements, ElemSize, Name + "_total_bytes");
@@ -145,25 +142,18 @@ void ArrayHandler::emitArrayDeclare(ArrayDeclareStmtAST *Stmt, CodeGen &CG) {
     AllocaInst *Alloca = CG.CreateEntryBlockAlloca(TheFunction, PointerType::getUnqual(*TheContext), Name);
     Builder->CreateStore(Ptr, Alloca);
 
-    CG.registerSymbol(Name, Alloca, ElemInfo->Name, true);
+    CG.registerSymbol(ID, Alloca, ElemInfo, true);
 }
 
 Value *ArrayHandler::emitArrayAccess(ArrayAccessExprAST *Expr, CodeGen &CG) {
-    std::string Name = Expr->getName();
-    const ArrayMetadata *Meta = getMetadata(Name);
-    if (!Meta) {
-        fprintf(stderr, "Error: Undeclared array %s\n", Name.c_str());
-        return nullptr;
-    }
-
-    if (Expr->getIndices().size() != static_cast<size_t>(Meta->Rank)) {
-        fprintf(stderr, "Error: Incorrect number of indices for %s\n", Name.c_str());
-        return nullptr;
-    }
+    SymbolID ID = Expr->getNameID();
+    StringRef Name = Names.get(ID);
+    const ArrayMetadata *Meta = getMetadata(ID);
+    if (!Meta || Expr->getIndices().size() != static_cast<size_t>(Meta->Rank)) return nullptr;
 
     std::vector<Value*> Indices;
     for (size_t i = 0; i < Expr->getIndices().size(); ++i) {
-        Value *Idx = CG.emitExpr(Expr->getIndices()[i].get());
+        Value *Idx = CG.emitExpr(Expr->getIndices()[i]);
         Idx = CG.coerceValueToType(Idx, CG.resolveType("INTEGER"));
         if (!Idx) return nullptr;
 
@@ -171,8 +161,8 @@ Value *ArrayHandler::emitArrayAccess(ArrayAccessExprAST *Expr, CodeGen &CG) {
         RuntimeChecker.emitIndexCheck(Idx, Meta->LowerBounds[i], Meta->UpperBounds[i], Expr->getLine());
     }
 
-    Value *Offset = computeFlatIndex(Name, Indices);
-    Value *ElemPtr = getElementPointer(Name, Offset);
+    Value *Offset = computeFlatIndex(ID, Indices);
+    Value *ElemPtr = getElementPointer(ID, Offset);
     if (!ElemPtr) return nullptr;
 
     Value *Val = Builder->CreateLoad(Meta->ElementType, ElemPtr, Name + "_elem");
@@ -186,21 +176,13 @@ Value *ArrayHandler::emitArrayAccess(ArrayAccessExprAST *Expr, CodeGen &CG) {
 }
 
 void ArrayHandler::emitArrayAssign(ArrayAssignStmtAST *Stmt, CodeGen &CG) {
-    std::string Name = Stmt->getName();
-    const ArrayMetadata *Meta = getMetadata(Name);
-    if (!Meta) {
-        fprintf(stderr, "Error: Undeclared array %s\n", Name.c_str());
-        return;
-    }
-
-    if (Stmt->getIndices().size() != static_cast<size_t>(Meta->Rank)) {
-        fprintf(stderr, "Error: Incorrect number of indices for %s\n", Name.c_str());
-        return;
-    }
+    SymbolID ID = Stmt->getNameID();
+    const ArrayMetadata *Meta = getMetadata(ID);
+    if (!Meta || Stmt->getIndices().size() != static_cast<size_t>(Meta->Rank)) return;
 
     std::vector<Value*> Indices;
     for (size_t i = 0; i < Stmt->getIndices().size(); ++i) {
-        Value *Idx = CG.emitExpr(Stmt->getIndices()[i].get());
+        Value *Idx = CG.emitExpr(Stmt->getIndices()[i]);
         Idx = CG.coerceValueToType(Idx, CG.resolveType("INTEGER"));
         if (!Idx) return;
 
@@ -209,41 +191,39 @@ void ArrayHandler::emitArrayAssign(ArrayAssignStmtAST *Stmt, CodeGen &CG) {
     }
 
     const TypeInfo *ElemInfo = Types.resolve(Meta->ElementTypeName);
+    CG.releaseString(Stmt->getExpr());
     Value *Val = CG.emitExpr(Stmt->getExpr());
     Val = CG.coerceValueToType(Val, ElemInfo);
     if (!Val) return;
 
-    Value *Offset = computeFlatIndex(Name, Indices);
-    Value *ElemPtr = getElementPointer(Name, Offset);
+    Value *Offset = computeFlatIndex(ID, Indices);
+    Value *ElemPtr = getElementPointer(ID, Offset);
     if (!ElemPtr) return;
 
     Builder->CreateStore(Val, ElemPtr);
 }
 
 bool ArrayHandler::tryEmitArrayOutput(ExprAST *Expr, CodeGen &CG) {
-    std::string Name;
+    SymbolID Name;
     std::vector<Value*> Indices;
 
-    if (auto *Var = dynamic_cast<VariableExprAST*>(Expr)) {
-        Name = Var->getName();
+    if (auto *Var = dyn_cast<VariableExprAST>(Expr)) {
+        Name = Var->getNameID();
         if (!getMetadata(Name)) return false;
-    } else if (auto *Acc = dynamic_cast<ArrayAccessExprAST*>(Expr)) {
-        Name = Acc->getName();
+    } else if (auto *Acc = dyn_cast<ArrayAccessExprAST>(Expr)) {
+        Name = Acc->getNameID();
         const ArrayMetadata *Meta = getMetadata(Name);
         if (!Meta) return false;
 
         for (size_t i = 0; i < Acc->getIndices().size(); ++i) {
-            Value *Idx = CG.emitExpr(Acc->getIndices()[i].get());
+            Value *Idx = CG.emitExpr(Acc->getIndices()[i]);
             Idx = CG.coerceValueToType(Idx, CG.resolveType("INTEGER"));
             if (!Idx) return false;
             Indices.push_back(Idx);
             RuntimeChecker.emitIndexCheck(Idx, Meta->LowerBounds[i], Meta->UpperBounds[i], Acc->getLine());
         }
 
-        if (Indices.size() > static_cast<size_t>(Meta->Rank)) {
-            fprintf(stderr, "Error: Incorrect number of indices for %s\n", Name.c_str());
-            return true;
-        }
+        if (Indices.size() > static_cast<size_t>(Meta->Rank)) return true;
     } else {
         return false;
     }
@@ -258,18 +238,19 @@ bool ArrayHandler::tryEmitArrayOutput(ExprAST *Expr, CodeGen &CG) {
     return true;
 }
 
-void ArrayHandler::emitPrintLoop(const std::string &Name,
+void ArrayHandler::emitPrintLoop(SymbolID ID,
                                  int CurrentDim,
                                  std::vector<Value*> CurrentIndices,
                                  CodeGen &CG) {
-    const ArrayMetadata *Meta = getMetadata(Name);
+    const ArrayMetadata *Meta = getMetadata(ID);
     if (!Meta) return;
 
     if (CurrentDim == Meta->Rank) {
-        Value *Offset = computeFlatIndex(Name, CurrentIndices);
-        Value *ElemPtr = getElementPointer(Name, Offset);
+        Value *Offset = computeFlatIndex(ID, CurrentIndices);
+        Value *ElemPtr = getElementPointer(ID, Offset);
         if (!ElemPtr) return;
 
+        StringRef Name = Names.get(ID);
         Value *Val = Builder->CreateLoad(Meta->ElementType, ElemPtr, Name + "_print_val");
         if (Meta->ElementTypeName == "STRING") {
             Value *IsNull = Builder->CreateICmpEQ(Val,
@@ -298,7 +279,7 @@ void ArrayHandler::emitPrintLoop(const std::string &Name,
 
     std::vector<Value*> NextIndices = CurrentIndices;
     NextIndices.push_back(CurVal);
-    emitPrintLoop(Name, CurrentDim + 1, NextIndices, CG);
+    emitPrintLoop(ID, CurrentDim + 1, NextIndices, CG);
 
     Value *NextVal = Builder->CreateAdd(CurVal, ConstantInt::get(*TheContext, APInt(64, 1)));
     Builder->CreateStore(NextVal, LoopVar);
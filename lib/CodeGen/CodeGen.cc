@@ -1,16 +1,16 @@
 #include "cps/CodeGen.h"
 #include "cps/ArrayHandler.h"
 #include "cps/Lexer.h"
+#include "cps/Optimizer.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Verifier.h"
-#include <cstdio>
 
 using namespace llvm;
 using namespace cps;
 
 CodeGen::~CodeGen() = default;
 
-CodeGen::CodeGen() {
+CodeGen::CodeGen(const Interner &Names, DiagnosticEngine &Diags) : Names(Names), Diags(Diags), Symbols(Names) {
     TheContext = std::make_unique<LLVMContext>();
     TheModule = std::make_unique<Module>("cps_module", *TheContext);
     Builder = std::make_unique<IRBuilder<>>(*TheContext);
@@ -21,7 +21,7 @@ CodeGen::CodeGen() {
     Arrays = std::make_unique<ArrayHandler>(*TheContext,
                                             *Builder,
                                             *TheModule,
-                                            NamedValues,
+                                            Names,
                                             Symbols,
                                             *Types,
                                             *RuntimeChecker);
@@ -30,20 +30,26 @@ CodeGen::CodeGen() {
                                             *TheModule,
                                             *Builder,
                                             *Types,
-                                            NamedValues,
+                                            Names,
+                                            Diags,
                                             Symbols);
 
-    IntHandler = std::make_unique<IntegerHandler>(*TheContext, *Builder, *TheModule, NamedValues);
-    RealHelper = std::make_unique<RealHandler>(*TheContext, *Builder, *TheModule, NamedValues);
-    BoolHandler = std::make_unique<BooleanHandler>(*TheContext, *Builder, *TheModule, NamedValues);
-    ArithHandler = std::make_unique<ArithmeticHandler>(*TheContext, *Builder);
-    StrHandler = std::make_unique<StringHandler>(*TheContext, *Builder, *TheModule, NamedValues);
+    IntHandler = std::make_unique<IntegerHandler>(*TheContext, *Builder, *TheModule);
+    RealHelper = std::make_unique<RealHandler>(*TheContext, *Builder, *TheModule);
+    BoolHandler = std::make_unique<BooleanHandler>(*TheContext, *Builder, *TheModule);
+    ArithHandler = std::make_unique<ArithmeticHandler>(*TheContext, *Builder, Diags);
+    StrHandler = std::make_unique<StringHandler>(*TheContext, *Builder, *TheModule);
     ChrHandler = std::make_unique<CharHandler>(*TheContext, *Builder, *TheModule);
-    StrConvHandler = std::make_unique<StringConversionHandler>(*TheContext, *Builder, *TheModule);
+    StrConvHandler = std::make_unique<StringConversionHandler>(*TheContext, *Builder, *TheModule, *StrHandler);
 
     SetupExternalFunctions();
 }
 
+void CodeGen::setTimeReport(TimeReport *T) {
+    Timer = T;
+    FuncGen->setTimeReport(T);
+}
+
 void CodeGen::SetupExternalFunctions() {
     std::vector<Type*> PrintfArgs;
     PrintfArgs.push_back(PointerType::getUnqual(*TheContext));
@@ -62,38 +68,34 @@ void CodeGen::SetupExternalFunctions() {
     ScanfFloatFormatStr = Builder->CreateGlobalStringPtr("%lf", "fmt_in_flt", 0, TheModule.get());
     ScanfStringFormatStr = Builder->CreateGlobalStringPtr("%s", "fmt_in_str", 0, TheModule.get());
 
-    TrueStr = Builder->CreateGlobalStringPtr("TRUE", "str_true", 0, TheModule.get());
-    FalseStr = Builder->CreateGlobalStringPtr("FALSE", "str_false", 0, TheModule.get());
-    EmptyStringStr = Builder->CreateGlobalStringPtr("", "str_empty", 0, TheModule.get());
+    TrueStr = StrHandler->createLiteral("TRUE", "str_true");
+    FalseStr = StrHandler->createLiteral("FALSE", "str_false");
+    EmptyStringStr = StrHandler->createLiteral("", "str_empty");
 
     Arrays->setupExternalFunctions();
 }
 
-AllocaInst *CodeGen::CreateEntryBlockAlloca(Function *TheFunction, const std::string &VarName) {
+AllocaInst *CodeGen::CreateEntryBlockAlloca(Function *TheFunction, const Twine &VarName) {
     return CreateEntryBlockAlloca(TheFunction, Type::getInt64Ty(*TheContext), VarName);
 }
 
 AllocaInst *CodeGen::CreateEntryBlockAlloca(Function *TheFunction,
                                             Type *AllocType,
-                                            const std::string &VarName) {
+                                            const Twine &VarName) {
     IRBuilder<> TmpB(&TheFunction->getEntryBlock(), TheFunction->getEntryBlock().begin());
     return TmpB.CreateAlloca(AllocType, nullptr, VarName);
 }
 
-void CodeGen::registerSymbol(const std::string &Name,
+void CodeGen::registerSymbol(SymbolID Name,
                              Value *Storage,
-                             const std::string &TypeName,
-                             bool IsArray) {
-    NamedValues[Name] = Storage;
-    Symbols[Name] = {Storage, TypeName, IsArray};
+                             const TypeInfo *Type,
+                             bool IsArray,
+                             Value *Capacity) {
+    Symbols.declare(Name, {Storage, Type, IsArray, Capacity});
 }
 
-const SymbolInfo *CodeGen::getSymbolInfo(const std::string &Name) const {
-    auto It = Symbols.find(Name);
-    if (It == Symbols.end()) {
-        return nullptr;
-    }
-    return &It->second;
+const SymbolInfo *CodeGen::getSymbolInfo(SymbolID Name) const {
+    return Symbols.lookup(Name);
 }
 
 const TypeInfo *CodeGen::resolveType(const std::string &TypeName) const {
@@ -104,84 +106,9 @@ Type *CodeGen::getLLVMType(const std::string &TypeName) const {
     return Types->getLLVMType(TypeName);
 }
 
-Value *CodeGen::getNamedValue(const std::string &Name) const {
-    auto It = NamedValues.find(Name);
-    return It == NamedValues.end() ? nullptr : It->second;
-}
-
-const TypeInfo *CodeGen::getExprTypeInfo(ExprAST *Expr) const {
-    if (!Expr) return nullptr;
-
-    if (dynamic_cast<IntegerExprAST*>(Expr)) return resolveType("INTEGER");
-    if (dynamic_cast<RealExprAST*>(Expr)) return resolveType("REAL");
-    if (dynamic_cast<BooleanExprAST*>(Expr)) return resolveType("BOOLEAN");
-    if (dynamic_cast<CharExprAST*>(Expr)) return resolveType("CHAR");
-    if (dynamic_cast<StringExprAST*>(Expr)) return resolveType("STRING");
-
-    if (auto *Var = dynamic_cast<VariableExprAST*>(Expr)) {
-        const SymbolInfo *Info = getSymbolInfo(Var->getName());
-        return Info ? resolveType(Info->TypeName) : nullptr;
-    }
-
-    if (auto *Arr = dynamic_cast<ArrayAccessExprAST*>(Expr)) {
-        const SymbolInfo *Info = getSymbolInfo(Arr->getName());
-        return Info ? resolveType(Info->TypeName) : nullptr;
-    }
-
-    if (auto *Unary = dynamic_cast<UnaryExprAST*>(Expr)) {
-        if (Unary->getOp() == tok_not) {
-            return resolveType("BOOLEAN");
-        }
-        return getExprTypeInfo(Unary->getOperand());
-    }
-
-    if (auto *Bin = dynamic_cast<BinaryExprAST*>(Expr)) {
-        switch (Bin->getOp()) {
-            case tok_eq:
-            case tok_ne:
-            case '<':
-            case '>':
-            case tok_le:
-            case tok_ge:
-            case tok_and:
-            case tok_or:
-                return resolveType("BOOLEAN");
-            case '&':
-                return resolveType("STRING");
-            default:
-                break;
-        }
-
-        const TypeInfo *L = getExprTypeInfo(Bin->getLHS());
-        const TypeInfo *R = getExprTypeInfo(Bin->getRHS());
-        if ((L && L->Kind == TypeKind::Real) || (R && R->Kind == TypeKind::Real)) {
-            return resolveType("REAL");
-        }
-        return resolveType("INTEGER");
-    }
-
-    if (auto *Call = dynamic_cast<CallExprAST*>(Expr)) {
-        const std::string &Name = Call->getCallee();
-        if (Name == "LENGTH" || Name == "ASC") return resolveType("INTEGER");
-        if (Name == "MID" || Name == "RIGHT" || Name == "LEFT" ||
-            Name == "LCASE" || Name == "UCASE" || Name == "CHR" ||
-            Name == "NUM_TO_STR") return resolveType("STRING");
-        if (Name == "IS_NUM") return resolveType("BOOLEAN");
-        if (Name == "STR_TO_NUM") return resolveType("REAL");
-
-        Function *CalleeF = TheModule->getFunction(Name);
-        if (!CalleeF) return resolveType("INTEGER");
-
-        Type *RetTy = CalleeF->getReturnType();
-        if (RetTy->isVoidTy()) return resolveType("VOID");
-        if (RetTy->isDoubleTy()) return resolveType("REAL");
-        if (RetTy->isIntegerTy(1)) return resolveType("BOOLEAN");
-        if (RetTy->isIntegerTy(8)) return resolveType("CHAR");
-        if (RetTy->isPointerTy()) return resolveType("STRING");
-        return resolveType("INTEGER");
-    }
-
-    return nullptr;
+Value *CodeGen::getNamedValue(SymbolID Name) const {
+    const SymbolInfo *Info = Symbols.lookup(Name);
+    return Info ? Info->Storage : nullptr;
 }
 
 Value *CodeGen::coerceValueToType(Value *Val, const TypeInfo *TargetInfo) {
@@ -245,25 +172,7 @@ Value *CodeGen::coerceValueToType(Value *Val, const TypeInfo *TargetInfo) {
                 return StrConvHandler->emitNumToStr(Val, true);
             }
             if (Val->getType()->isIntegerTy(8)) {
-                Function *MallocF = TheModule->getFunction("malloc");
-                if (!MallocF) {
-                    FunctionType *MallocTy = FunctionType::get(PointerType::getUnqual(*TheContext),
-                                                               {Type::getInt64Ty(*TheContext)},
-                                                               false);
-                    MallocF = Function::Create(MallocTy,
-                                               Function::ExternalLinkage,
-                                               "malloc",
-                                               TheModule.get());
-                }
-                Value *Mem = Builder->CreateCall(MallocF,
-                                                 ConstantInt::get(*TheContext, APInt(64, 2)),
-                                                 "char_str");
-                Builder->CreateStore(Val, Mem);
-                Value *NullPtr = Builder->CreateInBoundsGEP(Type::getInt8Ty(*TheContext),
-                                                            Mem,
-                                                            ConstantInt::get(*TheContext, APInt(64, 1)));
-                Builder->CreateStore(ConstantInt::get(Type::getInt8Ty(*TheContext), 0), NullPtr);
-                return Mem;
+                return StrHandler->emitFromChar(Val);
             }
             if (Val->getType()->isIntegerTy()) {
                 Value *AsInt = coerceValueToType(Val, resolveType("INTEGER"));
@@ -282,21 +191,16 @@ Value *CodeGen::coerceValueToType(Value *Val, const TypeInfo *TargetInfo) {
             break;
     }
 
-    fprintf(stderr,
-            "Error: Cannot coerce value of LLVM type to target type %s\n",
-            TargetInfo->Name.c_str());
+    Diags.error("Cannot coerce value of LLVM type to target type %s", TargetInfo->Name.c_str());
     return nullptr;
 }
 
 void CodeGen::emitDeclareStmt(DeclareStmtAST *Stmt) {
-    const TypeInfo *Info = resolveType(Stmt->getType());
-    if (!Info || !Info->LLVMType || Info->isVoid()) {
-        fprintf(stderr, "Error: Unknown type %s\n", Stmt->getType().c_str());
-        return;
-    }
+    const TypeInfo *Info = resolveType(Stmt->getType().str());
+    if (!Info || !Info->LLVMType || Info->isVoid()) return;
 
     Function *TheFunction = Builder->GetInsertBlock()->getParent();
-    AllocaInst *Alloca = CreateEntryBlockAlloca(TheFunction, Info->LLVMType, Stmt->getName());
+    AllocaInst *Alloca = CreateEntryBlockAlloca(TheFunction, Info->LLVMType, Names.get(Stmt->getNameID()));
 
     Value *InitVal = nullptr;
     if (Info->isString()) {
@@ -309,13 +213,65 @@ void CodeGen::emitDeclareStmt(DeclareStmtAST *Stmt) {
         Builder->CreateStore(InitVal, Alloca);
     }
 
-    registerSymbol(Stmt->getName(), Alloca, Info->Name, false);
+    AllocaInst *Capacity = nullptr;
+    if (Info->isString()) {
+        Capacity = CreateEntryBlockAlloca(TheFunction, Names.get(Stmt->getNameID()) + "_cap");
+        Builder->CreateStore(ConstantInt::get(*TheContext, APInt(64, 0)), Capacity);
+    }
+
+    registerSymbol(Stmt->getNameID(), Alloca, Info, false, Capacity);
+}
+
+void CodeGen::releaseString(const SymbolInfo *Info) {
+    if (Info && Info->Capacity)
+        Builder->CreateStore(ConstantInt::get(*TheContext, APInt(64, 0)), Info->Capacity);
+}
+
+void CodeGen::releaseString(ExprAST *Expr) {
+    // Every other expression yields a fresh string or none at all.
+    if (auto *Var = dyn_cast<VariableExprAST>(Expr))
+        releaseString(getSymbolInfo(Var->getNameID()));
+}
+
+// `s <- s & a & b ...` appends to s's buffer instead of copying it. The
+// buffer never escapes while s owns it, so nothing can see it change.
+bool CodeGen::tryEmitStringAppend(AssignStmtAST *Assign) {
+    const SymbolInfo *Info = getSymbolInfo(Assign->getNameID());
+    if (!Info || !Info->Capacity) return false;
+
+    std::vector<ExprAST*> PartExprs;
+    ExprAST *Head = Assign->getExpr();
+    while (auto *Bin = dyn_cast<BinaryExprAST>(Head)) {
+        if (Bin->getOp() != '&') return false;
+        PartExprs.push_back(Bin->getRHS());
+        Head = Bin->getLHS();
+    }
+    auto *Self = dyn_cast<VariableExprAST>(Head);
+    if (PartExprs.empty() || !Self || Self->getNameID() != Assign->getNameID()) return false;
+    // `s <- s & s` would copy from the buffer it is growing.
+    for (ExprAST *Part : PartExprs) {
+        auto *Var = dyn_cast<VariableExprAST>(Part);
+        if (Var && Var->getNameID() == Assign->getNameID()) return false;
+    }
+
+    // Same evaluation order as the concatenation it replaces.
+    Value *Str = emitExpr(Self);
+    if (!Str) return true;
+    const TypeInfo *StringType = resolveType("STRING");
+    std::vector<Value*> Parts;
+    for (auto It = PartExprs.rbegin(); It != PartExprs.rend(); ++It) {
+        Value *Part = coerceValueToType(emitExpr(*It), StringType);
+        if (!Part) return true;
+        Parts.push_back(Part);
+    }
+    StrHandler->emitAppend(Info->Storage, Info->Capacity, Str, Parts);
+    return true;
 }
 
 void CodeGen::emitOutputValue(Value *Val, const TypeInfo *Info, bool AppendNewline) {
     if (!Val || !Info) return;
     if (!Info->Printable && Info->Kind == TypeKind::Custom) {
-        fprintf(stderr, "Error: OUTPUT for custom type %s is not implemented yet\n", Info->Name.c_str());
+        Diags.error("OUTPUT for custom type %s is not implemented yet", Info->Name.c_str());
         return;
     }
 
@@ -368,21 +324,35 @@ void CodeGen::emitOutputValue(Value *Val, const TypeInfo *Info, bool AppendNewli
     Builder->CreateCall(PrintfFunc, Args);
 }
 
-void CodeGen::compile(const std::vector<std::unique_ptr<StmtAST>> &Statements) {
+void CodeGen::beginMain() {
+    if (Timer) MainPhase = Timer->getPhase("codegen: main");
+
     FunctionType *FT = FunctionType::get(Type::getInt32Ty(*TheContext), false);
     Function *F = Function::Create(FT, Function::ExternalLinkage, "main", TheModule.get());
     BasicBlock *BB = BasicBlock::Create(*TheContext, "entry", F);
     Builder->SetInsertPoint(BB);
+}
 
-    for (const auto &Stmt : Statements) {
-        emitStmt(Stmt.get());
-    }
+void CodeGen::emitTopLevel(StmtAST *Stmt) {
+    TimeReport::Scope Emitting(Timer, MainPhase);
+    emitStmt(Stmt);
+}
 
-    if (!Builder->GetInsertBlock()->getTerminator()) {
-        Builder->CreateRet(ConstantInt::get(*TheContext, APInt(32, 0)));
+void CodeGen::finishMain() {
+    {
+        TimeReport::Scope Emitting(Timer, MainPhase);
+        if (!Builder->GetInsertBlock()->getTerminator()) {
+            Builder->CreateRet(ConstantInt::get(*TheContext, APInt(32, 0)));
+        }
     }
 
-    verifyFunction(*F);
+    TimeReport::Scope Verifying(Timer, "verify");
+    verifyFunction(*TheModule->getFunction("main"));
+}
+
+bool CodeGen::optimize(unsigned OptLevel, TargetMachine *TM) {
+    Optimizer Opt(OptLevel, Diags, TM, Timer);
+    return Opt.run(*TheModule);
 }
 
 void CodeGen::print() {
@@ -392,177 +362,167 @@ void CodeGen::print() {
 Value *CodeGen::emitExpr(ExprAST *Expr) {
     if (!Expr) return nullptr;
 
-    if (auto *Num = dynamic_cast<IntegerExprAST*>(Expr)) {
-        return IntHandler->createLiteral(Num->getVal());
-    }
-
-    if (auto *Real = dynamic_cast<RealExprAST*>(Expr)) {
-        return RealHelper->createLiteral(Real->getVal());
-    }
-
-    if (auto *Bool = dynamic_cast<BooleanExprAST*>(Expr)) {
-        return BoolHandler->createLiteral(Bool->getVal());
-    }
-
-    if (auto *Chr = dynamic_cast<CharExprAST*>(Expr)) {
-        return ConstantInt::get(Type::getInt8Ty(*TheContext), static_cast<unsigned char>(Chr->getVal()));
-    }
+    switch (Expr->getKind()) {
+        case ExprAST::EK_Integer:
+            return IntHandler->createLiteral(cast<IntegerExprAST>(Expr)->getVal());
+        case ExprAST::EK_Real:
+            return RealHelper->createLiteral(cast<RealExprAST>(Expr)->getVal());
+        case ExprAST::EK_Boolean:
+            return BoolHandler->createLiteral(cast<BooleanExprAST>(Expr)->getVal());
+        case ExprAST::EK_Char:
+            return ConstantInt::get(Type::getInt8Ty(*TheContext), static_cast<unsigned char>(cast<CharExprAST>(Expr)->getVal()));
+        case ExprAST::EK_String:
+            return StrHandler->createLiteral(cast<StringExprAST>(Expr)->getVal());
+        case ExprAST::EK_Variable: {
+            auto *Var = cast<VariableExprAST>(Expr);
+            const SymbolInfo *Info = getSymbolInfo(Var->getNameID());
+            if (!Info) return nullptr;
+            if (Info->IsArray) {
+                return Info->Storage;
+            }
 
-    if (auto *Str = dynamic_cast<StringExprAST*>(Expr)) {
-        return StrHandler->createLiteral(Str->getVal());
-    }
+            const TypeInfo *TypeInfo = Var->getType();
+            if (!TypeInfo || !TypeInfo->LLVMType) return nullptr;
 
-    if (auto *Var = dynamic_cast<VariableExprAST*>(Expr)) {
-        const SymbolInfo *Info = getSymbolInfo(Var->getName());
-        if (!Info) {
-            fprintf(stderr, "Error: Unknown variable name %s\n", Var->getName().c_str());
-            return nullptr;
-        }
-        if (Info->IsArray) {
-            return Info->Storage;
+            Value *Loaded = Builder->CreateLoad(TypeInfo->LLVMType, Info->Storage, Names.get(Var->getNameID()));
+            if (TypeInfo->isString()) {
+                Value *IsNull = Builder->CreateICmpEQ(Loaded,
+                                                      ConstantPointerNull::get(cast<PointerType>(Loaded->getType())),
+                                                      "str_is_null");
+                Loaded = Builder->CreateSelect(IsNull, EmptyStringStr, Loaded, "safe_var_str");
+            }
+            return Loaded;
         }
-
-        const TypeInfo *TypeInfo = resolveType(Info->TypeName);
-        if (!TypeInfo || !TypeInfo->LLVMType) {
-            fprintf(stderr, "Error: Unknown type for variable %s\n", Var->getName().c_str());
+        case ExprAST::EK_ArrayAccess:
+            return Arrays->emitArrayAccess(cast<ArrayAccessExprAST>(Expr), *this);
+        case ExprAST::EK_Unary: {
+            auto *Unary = cast<UnaryExprAST>(Expr);
+            Value *Operand = emitExpr(Unary->getOperand());
+            if (!Operand) return nullptr;
+
+            if (Unary->getOp() == tok_not) {
+                Operand = coerceValueToType(Operand, resolveType("BOOLEAN"));
+                return Builder->CreateNot(Operand, "nottmp");
+            }
             return nullptr;
         }
-
-        Value *Loaded = Builder->CreateLoad(TypeInfo->LLVMType, Info->Storage, Var->getName().c_str());
-        if (TypeInfo->isString()) {
-            Value *IsNull = Builder->CreateICmpEQ(Loaded,
-                                                  ConstantPointerNull::get(cast<PointerType>(Loaded->getType())),
-                                                  "str_is_null");
-            Loaded = Builder->CreateSelect(IsNull, EmptyStringStr, Loaded, "safe_var_str");
-        }
-        return Loaded;
-    }
-
-    if (auto *ArrAcc = dynamic_cast<ArrayAccessExprAST*>(Expr)) {
-        return Arrays->emitArrayAccess(ArrAcc, *this);
-    }
-
-    if (auto *Unary = dynamic_cast<UnaryExprAST*>(Expr)) {
-        Value *Operand = emitExpr(Unary->getOperand());
-        if (!Operand) return nullptr;
-
-        if (Unary->getOp() == tok_not) {
-            Operand = coerceValueToType(Operand, resolveType("BOOLEAN"));
-            return Builder->CreateNot(Operand, "nottmp");
-        }
-    }
-
-    if (auto *Bin = dynamic_cast<BinaryExprAST*>(Expr)) {
-        Value *L = emitExpr(Bin->getLHS());
-        Value *R = emitExpr(Bin->getRHS());
-        if (!L || !R) return nullptr;
-        return ArithHandler->emitBinaryOp(Bin->getOp(), L, R, Bin->getLine());
-    }
-
-    if (auto *Call = dynamic_cast<CallExprAST*>(Expr)) {
-        std::string Name = Call->getCallee();
-        if (Name == "LENGTH") {
-            if (Call->getArgs().size() != 1) { fprintf(stderr, "LENGTH expects 1 arg\n"); return nullptr; }
-            return StrHandler->emitLength(emitExpr(Call->getArgs()[0].get()));
-        }
-        if (Name == "MID") {
-            if (Call->getArgs().size() != 3) { fprintf(stderr, "MID expects 3 args\n"); return nullptr; }
-            return StrHandler->emitMid(emitExpr(Call->getArgs()[0].get()),
-                                       emitExpr(Call->getArgs()[1].get()),
-                                       emitExpr(Call->getArgs()[2].get()));
-        }
-        if (Name == "RIGHT") {
-            if (Call->getArgs().size() != 2) { fprintf(stderr, "RIGHT expects 2 args\n"); return nullptr; }
-            return StrHandler->emitRight(emitExpr(Call->getArgs()[0].get()),
-                                         emitExpr(Call->getArgs()[1].get()));
-        }
-        if (Name == "LEFT") {
-            if (Call->getArgs().size() != 2) { fprintf(stderr, "LEFT expects 2 args\n"); return nullptr; }
-            return StrHandler->emitLeft(emitExpr(Call->getArgs()[0].get()),
-                                        emitExpr(Call->getArgs()[1].get()));
-        }
-        if (Name == "LCASE") {
-            if (Call->getArgs().size() != 1) { fprintf(stderr, "LCASE expects 1 arg\n"); return nullptr; }
-            return StrHandler->emitLCase(emitExpr(Call->getArgs()[0].get()));
-        }
-        if (Name == "UCASE") {
-            if (Call->getArgs().size() != 1) { fprintf(stderr, "UCASE expects 1 arg\n"); return nullptr; }
-            return StrHandler->emitUCase(emitExpr(Call->getArgs()[0].get()));
-        }
-        if (Name == "ASC") {
-            if (Call->getArgs().size() != 1) return nullptr;
-            Value *ArgVal = emitExpr(Call->getArgs()[0].get());
-            const TypeInfo *ArgType = getExprTypeInfo(Call->getArgs()[0].get());
-            Value *CharVal = nullptr;
-            if (ArgType && ArgType->isChar()) {
-                CharVal = coerceValueToType(ArgVal, resolveType("CHAR"));
-            } else {
-                CharVal = Builder->CreateLoad(Type::getInt8Ty(*TheContext), ArgVal, "char_load");
+        case ExprAST::EK_Binary: {
+            auto *Bin = cast<BinaryExprAST>(Expr);
+            Value *L = emitExpr(Bin->getLHS());
+            Value *R = emitExpr(Bin->getRHS());
+            if (!L || !R) return nullptr;
+            if (Bin->getOp() == '&') {
+                const TypeInfo *StringType = resolveType("STRING");
+                L = coerceValueToType(L, StringType);
+                R = coerceValueToType(R, StringType);
+                if (!L || !R) return nullptr;
+                return StrHandler->emitConcat(L, R);
             }
-            Value *AscVal = ChrHandler->emitAsc(CharVal);
-            return coerceValueToType(AscVal, resolveType("INTEGER"));
-        }
-        if (Name == "CHR") {
-            if (Call->getArgs().size() != 1) return nullptr;
-            Value *IntVal = coerceValueToType(emitExpr(Call->getArgs()[0].get()), resolveType("INTEGER"));
-            Value *CharVal = ChrHandler->emitChr(IntVal);
-            Function *MallocF = TheModule->getFunction("malloc");
-            Value *Mem = Builder->CreateCall(MallocF, ConstantInt::get(*TheContext, APInt(64, 2)));
-            Builder->CreateStore(CharVal, Mem);
-            Value *NullPtr = Builder->CreateInBoundsGEP(Type::getInt8Ty(*TheContext),
-                                                        Mem,
-                                                        ConstantInt::get(*TheContext, APInt(64, 1)));
-            Builder->CreateStore(ConstantInt::get(Type::getInt8Ty(*TheContext), 0), NullPtr);
-            return Mem;
-        }
-        if (Name == "IS_NUM") {
-            if (Call->getArgs().size() != 1) return nullptr;
-            return StrConvHandler->emitIsNum(emitExpr(Call->getArgs()[0].get()));
+            return ArithHandler->emitBinaryOp(Bin->getOp(), L, R, Bin->getLine());
         }
-        if (Name == "NUM_TO_STR") {
-            if (Call->getArgs().size() != 1) return nullptr;
-            Value *NumV = emitExpr(Call->getArgs()[0].get());
-            bool IsReal = NumV->getType()->isDoubleTy();
-            if (NumV->getType()->isIntegerTy(8)) {
-                NumV = coerceValueToType(NumV, resolveType("INTEGER"));
+        case ExprAST::EK_Call: {
+            auto *Call = cast<CallExprAST>(Expr);
+            switch (Call->getCalleeID()) {
+                case Builtin_LENGTH: {
+                    if (Call->getArgs().size() != 1) return nullptr;
+                    return StrHandler->emitLength(emitExpr(Call->getArgs()[0]));
+                }
+                case Builtin_MID: {
+                    if (Call->getArgs().size() != 3) return nullptr;
+                    return StrHandler->emitMid(emitExpr(Call->getArgs()[0]),
+                                               emitExpr(Call->getArgs()[1]),
+                                               emitExpr(Call->getArgs()[2]));
+                }
+                case Builtin_RIGHT: {
+                    if (Call->getArgs().size() != 2) return nullptr;
+                    return StrHandler->emitRight(emitExpr(Call->getArgs()[0]),
+                                                 emitExpr(Call->getArgs()[1]));
+                }
+                case Builtin_LEFT: {
+                    if (Call->getArgs().size() != 2) return nullptr;
+                    return StrHandler->emitLeft(emitExpr(Call->getArgs()[0]),
+                                                emitExpr(Call->getArgs()[1]));
+                }
+                case Builtin_LCASE: {
+                    if (Call->getArgs().size() != 1) return nullptr;
+                    return StrHandler->emitLCase(emitExpr(Call->getArgs()[0]));
+                }
+                case Builtin_UCASE: {
+                    if (Call->getArgs().size() != 1) return nullptr;
+                    return StrHandler->emitUCase(emitExpr(Call->getArgs()[0]));
+                }
+                case Builtin_ASC: {
+                    if (Call->getArgs().size() != 1) return nullptr;
+                    Value *ArgVal = emitExpr(Call->getArgs()[0]);
+                    const TypeInfo *ArgType = Call->getArgs()[0]->getType();
+                    Value *CharVal = nullptr;
+                    if (ArgType && ArgType->isChar()) {
+                        CharVal = coerceValueToType(ArgVal, resolveType("CHAR"));
+                    } else {
+                        CharVal = Builder->CreateLoad(Type::getInt8Ty(*TheContext), ArgVal, "char_load");
+                    }
+                    Value *AscVal = ChrHandler->emitAsc(CharVal);
+                    return coerceValueToType(AscVal, resolveType("INTEGER"));
+                }
+                case Builtin_CHR: {
+                    if (Call->getArgs().size() != 1) return nullptr;
+                    Value *IntVal = coerceValueToType(emitExpr(Call->getArgs()[0]), resolveType("INTEGER"));
+                    Value *CharVal = ChrHandler->emitChr(IntVal);
+                    return StrHandler->emitFromChar(CharVal);
+                }
+                case Builtin_IS_NUM: {
+                    if (Call->getArgs().size() != 1) return nullptr;
+                    return StrConvHandler->emitIsNum(emitExpr(Call->getArgs()[0]));
+                }
+                case Builtin_NUM_TO_STR: {
+                    if (Call->getArgs().size() != 1) return nullptr;
+                    Value *NumV = emitExpr(Call->getArgs()[0]);
+                    bool IsReal = NumV->getType()->isDoubleTy();
+                    if (NumV->getType()->isIntegerTy(8)) {
+                        NumV = coerceValueToType(NumV, resolveType("INTEGER"));
+                    }
+                    return StrConvHandler->emitNumToStr(NumV, IsReal);
+                }
+                case Builtin_STR_TO_NUM: {
+                    if (Call->getArgs().size() != 1) return nullptr;
+                    return StrConvHandler->emitStrToNum(emitExpr(Call->getArgs()[0]), true);
+                }
+                default:
+                    break;
             }
-            return StrConvHandler->emitNumToStr(NumV, IsReal);
-        }
-        if (Name == "STR_TO_NUM") {
-            if (Call->getArgs().size() != 1) return nullptr;
-            return StrConvHandler->emitStrToNum(emitExpr(Call->getArgs()[0].get()), true);
-        }
 
-        Function *CalleeF = TheModule->getFunction(Call->getCallee());
-        std::vector<Value*> Args;
+            Function *CalleeF = FuncGen->getFunction(Call->getCalleeID());
+            std::vector<Value*> Args;
 
-        for (unsigned i = 0; i < Call->getArgs().size(); ++i) {
-            ExprAST *ArgExpr = Call->getArgs()[i].get();
-            bool IsByRef = false;
+            for (unsigned i = 0; i < Call->getArgs().size(); ++i) {
+                ExprAST *ArgExpr = Call->getArgs()[i];
+                bool IsByRef = false;
 
-            if (CalleeF && i < CalleeF->arg_size()) {
-                if (CalleeF->getArg(i)->getType()->isPointerTy()) {
-                    IsByRef = true;
+                if (CalleeF && i < CalleeF->arg_size()) {
+                    if (CalleeF->getArg(i)->getType()->isPointerTy()) {
+                        IsByRef = true;
+                    }
                 }
-            }
 
-            if (IsByRef) {
-                if (auto *Var = dynamic_cast<VariableExprAST*>(ArgExpr)) {
-                    Value *Ptr = getNamedValue(Var->getName());
-                    if (!Ptr) {
-                        fprintf(stderr, "Error: Unknown variable %s in BYREF call\n", Var->getName().c_str());
+                releaseString(ArgExpr);
+                if (IsByRef) {
+                    if (auto *Var = dyn_cast<VariableExprAST>(ArgExpr)) {
+                        Value *Ptr = getNamedValue(Var->getNameID());
+                        if (!Ptr) {
+                            Diags.error("Unknown variable %s in BYREF call", Names.get(Var->getNameID()).data());
+                            return nullptr;
+                        }
+                        Args.push_back(Ptr);
+                    } else {
+                        Diags.error("BYREF argument must be a variable.");
                         return nullptr;
                     }
-                    Args.push_back(Ptr);
                 } else {
-                    fprintf(stderr, "Error: BYREF argument must be a variable.\n");
-                    return nullptr;
+                    Args.push_back(emitExpr(ArgExpr));
                 }
-            } else {
-                Args.push_back(emitExpr(ArgExpr));
             }
+            return FuncGen->emitCallExpr(Call, Args);
         }
-        return FuncGen->emitCallExpr(Call, Args);
     }
 
     return nullptr;
@@ -582,11 +542,11 @@ void CodeGen::emitIfStmt(IfStmtAST *Stmt) {
     Builder->CreateCondBr(CondV, ThenBB, ElseBB);
 
     Builder->SetInsertPoint(ThenBB);
-    for (const auto &S : Stmt->getThenStmts()) emitStmt(S.get());
+    for (const auto &S : Stmt->getThenStmts()) emitStmt(S);
     if (!Builder->GetInsertBlock()->getTerminator()) Builder->CreateBr(MergeBB);
 
     Builder->SetInsertPoint(ElseBB);
-    for (const auto &S : Stmt->getElseStmts()) emitStmt(S.get());
+    for (const auto &S : Stmt->getElseStmts()) emitStmt(S);
     if (!Builder->GetInsertBlock()->getTerminator()) Builder->CreateBr(MergeBB);
 
     Builder->SetInsertPoint(MergeBB);
@@ -609,7 +569,7 @@ void CodeGen::emitWhileStmt(WhileStmtAST *Stmt) {
     Builder->CreateCondBr(CondV, LoopBB, AfterBB);
 
     Builder->SetInsertPoint(LoopBB);
-    for (const auto &S : Stmt->getBody()) emitStmt(S.get());
+    for (const auto &S : Stmt->getBody()) emitStmt(S);
 
     if (!Builder->GetInsertBlock()->getTerminator())
         Builder->CreateBr(CondBB);
@@ -627,7 +587,7 @@ void CodeGen::emitRepeatStmt(RepeatStmtAST *Stmt) {
     Builder->CreateBr(LoopBB);
 
     Builder->SetInsertPoint(LoopBB);
-    for (const auto &S : Stmt->getBody()) emitStmt(S.get());
+    for (const auto &S : Stmt->getBody()) emitStmt(S);
     if (!Builder->GetInsertBlock()->getTerminator())
         Builder->CreateBr(CondBB);
 
@@ -643,17 +603,10 @@ void CodeGen::emitRepeatStmt(RepeatStmtAST *Stmt) {
 
 void CodeGen::emitForStmt(ForStmtAST *Stmt) {
     Function *TheFunction = Builder->GetInsertBlock()->getParent();
-    std::string VarName = Stmt->getVarName();
+    StringRef VarName = Names.get(Stmt->getVarNameID());
 
-    const SymbolInfo *Symbol = getSymbolInfo(VarName);
-    if (!Symbol) {
-        fprintf(stderr, "Error: Unknown variable in FOR loop %s\n", VarName.c_str());
-        return;
-    }
-    if (Symbol->TypeName != "INTEGER") {
-        fprintf(stderr, "Error: FOR loop variable %s must be INTEGER\n", VarName.c_str());
-        return;
-    }
+    const SymbolInfo *Symbol = getSymbolInfo(Stmt->getVarNameID());
+    if (!Symbol || !Symbol->Type || Symbol->Type->Kind != TypeKind::Integer) return;
 
     Value *StartVal = coerceValueToType(emitExpr(Stmt->getStart()), resolveType("INTEGER"));
     if (!StartVal) return;
@@ -669,13 +622,13 @@ void CodeGen::emitForStmt(ForStmtAST *Stmt) {
     Builder->CreateBr(CondBB);
     Builder->SetInsertPoint(CondBB);
 
-    Value *CurVar = Builder->CreateLoad(Type::getInt64Ty(*TheContext), Alloca, VarName.c_str());
+    Value *CurVar = Builder->CreateLoad(Type::getInt64Ty(*TheContext), Alloca, VarName);
     Value *EndVal = coerceValueToType(emitExpr(Stmt->getEnd()), resolveType("INTEGER"));
     if (!EndVal) return;
 
     bool IsNegativeStep = false;
     if (Stmt->getStep()) {
-        if (auto *Num = dynamic_cast<IntegerExprAST*>(Stmt->getStep())) {
+        if (auto *Num = dyn_cast<IntegerExprAST>(Stmt->getStep())) {
             if (Num->getVal() < 0) IsNegativeStep = true;
         }
     }
@@ -687,7 +640,7 @@ void CodeGen::emitForStmt(ForStmtAST *Stmt) {
     Builder->CreateCondBr(CondV, LoopBB, AfterBB);
 
     Builder->SetInsertPoint(LoopBB);
-    for (const auto &S : Stmt->getBody()) emitStmt(S.get());
+    for (const auto &S : Stmt->getBody()) emitStmt(S);
     if (!Builder->GetInsertBlock()->getTerminator())
         Builder->CreateBr(IncBB);
 
@@ -699,7 +652,7 @@ void CodeGen::emitForStmt(ForStmtAST *Stmt) {
         StepVal = ConstantInt::get(*TheContext, APInt(64, 1));
     }
 
-    Value *CurValForInc = Builder->CreateLoad(Type::getInt64Ty(*TheContext), Alloca, VarName.c_str());
+    Value *CurValForInc = Builder->CreateLoad(Type::getInt64Ty(*TheContext), Alloca, VarName);
     Value *NextVal = Builder->CreateAdd(CurValForInc, StepVal, "nextval");
     Builder->CreateStore(NextVal, Alloca);
     Builder->CreateBr(CondBB);
@@ -710,171 +663,153 @@ void CodeGen::emitForStmt(ForStmtAST *Stmt) {
 void CodeGen::emitStmt(StmtAST *Stmt) {
     if (!Stmt) return;
 
-    if (auto *ArrDecl = dynamic_cast<ArrayDeclareStmtAST*>(Stmt)) {
-        Arrays->emitArrayDeclare(ArrDecl, *this);
-        return;
-    }
-
-    if (auto *ArrAssign = dynamic_cast<ArrayAssignStmtAST*>(Stmt)) {
-        Arrays->emitArrayAssign(ArrAssign, *this);
-        return;
-    }
-
-    if (auto *FuncDef = dynamic_cast<FunctionDefAST*>(Stmt)) {
-        BasicBlock *SavedBlock = Builder->GetInsertBlock();
-
-        FuncGen->emitFunctionDef(FuncDef, [this](StmtAST *S) {
-            this->emitStmt(S);
-        });
-
-        if (SavedBlock) Builder->SetInsertPoint(SavedBlock);
-        return;
-    }
-
-    if (auto *Call = dynamic_cast<CallStmtAST*>(Stmt)) {
-        Function *CalleeF = TheModule->getFunction(Call->getCallee());
-        std::vector<Value*> Args;
+    switch (Stmt->getKind()) {
+        case StmtAST::SK_ArrayDeclare:
+            Arrays->emitArrayDeclare(cast<ArrayDeclareStmtAST>(Stmt), *this);
+            return;
+        case StmtAST::SK_ArrayAssign:
+            Arrays->emitArrayAssign(cast<ArrayAssignStmtAST>(Stmt), *this);
+            return;
+        case StmtAST::SK_FunctionDef: {
+            auto *FuncDef = cast<FunctionDefAST>(Stmt);
+            TimeReport::Scope Emitting(Timer, Timer ? "codegen: " + Names.get(FuncDef->getProto()->getNameID()).str() : std::string());
+            BasicBlock *SavedBlock = Builder->GetInsertBlock();
 
-        for (unsigned i = 0; i < Call->getArgs().size(); ++i) {
-            ExprAST *ArgExpr = Call->getArgs()[i].get();
-            bool IsByRef = false;
+            FuncGen->emitFunctionDef(FuncDef, [this](StmtAST *S) {
+                this->emitStmt(S);
+            });
 
-            if (CalleeF && i < CalleeF->arg_size()) {
-                if (CalleeF->getArg(i)->getType()->isPointerTy()) {
-                    IsByRef = true;
+            if (SavedBlock) Builder->SetInsertPoint(SavedBlock);
+            return;
+        }
+        case StmtAST::SK_Call: {
+            auto *Call = cast<CallStmtAST>(Stmt);
+            Function *CalleeF = FuncGen->getFunction(Call->getCalleeID());
+            std::vector<Value*> Args;
+
+            for (unsigned i = 0; i < Call->getArgs().size(); ++i) {
+                ExprAST *ArgExpr = Call->getArgs()[i];
+                bool IsByRef = false;
+
+                if (CalleeF && i < CalleeF->arg_size()) {
+                    if (CalleeF->getArg(i)->getType()->isPointerTy()) {
+                        IsByRef = true;
+                    }
                 }
-            }
 
-            if (IsByRef) {
-                if (auto *Var = dynamic_cast<VariableExprAST*>(ArgExpr)) {
-                    Value *Ptr = getNamedValue(Var->getName());
-                    if (!Ptr) {
-                        fprintf(stderr, "Error: Unknown variable %s in BYREF call\n", Var->getName().c_str());
+                releaseString(ArgExpr);
+                if (IsByRef) {
+                    if (auto *Var = dyn_cast<VariableExprAST>(ArgExpr)) {
+                        Value *Ptr = getNamedValue(Var->getNameID());
+                        if (!Ptr) {
+                            Diags.error("Unknown variable %s in BYREF call", Names.get(Var->getNameID()).data());
+                            return;
+                        }
+                        Args.push_back(Ptr);
+                    } else {
+                        Diags.error("BYREF argument must be a variable.");
                         return;
                     }
-                    Args.push_back(Ptr);
                 } else {
-                    fprintf(stderr, "Error: BYREF argument must be a variable.\n");
-                    return;
+                    Args.push_back(emitExpr(ArgExpr));
                 }
-            } else {
-                Args.push_back(emitExpr(ArgExpr));
             }
-        }
-        FuncGen->emitCallStmt(Call, Args);
-        return;
-    }
-
-    if (auto *Ret = dynamic_cast<ReturnStmtAST*>(Stmt)) {
-        Value *RetVal = nullptr;
-        if (Ret->getRetVal()) {
-            RetVal = emitExpr(Ret->getRetVal());
-        }
-        FuncGen->emitReturn(Ret, RetVal);
-        return;
-    }
-
-    if (auto *Decl = dynamic_cast<DeclareStmtAST*>(Stmt)) {
-        emitDeclareStmt(Decl);
-        return;
-    }
-
-    if (auto *Assign = dynamic_cast<AssignStmtAST*>(Stmt)) {
-        const SymbolInfo *Info = getSymbolInfo(Assign->getName());
-        if (!Info) {
-            fprintf(stderr, "Error: Unknown variable name %s\n", Assign->getName().c_str());
+            FuncGen->emitCallStmt(Call, Args);
             return;
         }
-        if (Info->IsArray) {
-            fprintf(stderr, "Error: Cannot assign array %s without indices\n", Assign->getName().c_str());
+        case StmtAST::SK_Return: {
+            auto *Ret = cast<ReturnStmtAST>(Stmt);
+            Value *RetVal = nullptr;
+            if (Ret->getRetVal()) {
+                releaseString(Ret->getRetVal());
+                RetVal = emitExpr(Ret->getRetVal());
+            }
+            FuncGen->emitReturn(Ret, RetVal);
             return;
         }
-
-        Value *Val = emitExpr(Assign->getExpr());
-        const TypeInfo *TargetType = resolveType(Info->TypeName);
-        Val = coerceValueToType(Val, TargetType);
-        if (!Val) return;
-
-        Builder->CreateStore(Val, Info->Storage);
-        return;
-    }
-
-    if (auto *In = dynamic_cast<InputStmtAST*>(Stmt)) {
-        const SymbolInfo *Info = getSymbolInfo(In->getName());
-        if (!Info) {
-            fprintf(stderr, "Error: Unknown variable name %s\n", In->getName().c_str());
+        case StmtAST::SK_Declare:
+            emitDeclareStmt(cast<DeclareStmtAST>(Stmt));
             return;
-        }
-        if (Info->IsArray) {
-            fprintf(stderr, "Error: INPUT for entire array %s is not supported\n", In->getName().c_str());
+        case StmtAST::SK_Assign: {
+            auto *Assign = cast<AssignStmtAST>(Stmt);
+            const SymbolInfo *Info = getSymbolInfo(Assign->getNameID());
+            if (!Info || Info->IsArray) return;
+            if (tryEmitStringAppend(Assign)) return;
+
+            releaseString(Assign->getExpr());
+            Value *Val = emitExpr(Assign->getExpr());
+            const TypeInfo *TargetType = Info->Type;
+            Val = coerceValueToType(Val, TargetType);
+            if (!Val) return;
+
+            Builder->CreateStore(Val, Info->Storage);
+            releaseString(Info);
             return;
         }
-
-        const TypeInfo *TypeInfo = resolveType(Info->TypeName);
-        if (!TypeInfo) {
-            fprintf(stderr, "Error: Unknown type for INPUT %s\n", In->getName().c_str());
+        case StmtAST::SK_Input: {
+            auto *In = cast<InputStmtAST>(Stmt);
+            const SymbolInfo *Info = getSymbolInfo(In->getNameID());
+            if (!Info || Info->IsArray) return;
+
+            const TypeInfo *TypeInfo = Info->Type;
+            if (!TypeInfo) return;
+
+            std::vector<Value*> Args;
+            if (TypeInfo->isReal()) {
+                Args.push_back(ScanfFloatFormatStr);
+                Args.push_back(Info->Storage);
+                Builder->CreateCall(ScanfFunc, Args);
+            } else if (TypeInfo->isBoolean()) {
+                AllocaInst *TempInt = CreateEntryBlockAlloca(Builder->GetInsertBlock()->getParent(), "tmp_bool_input");
+                Args.push_back(ScanfFormatStr);
+                Args.push_back(TempInt);
+                Builder->CreateCall(ScanfFunc, Args);
+
+                Value *Val = Builder->CreateLoad(Type::getInt64Ty(*TheContext), TempInt);
+                Value *BoolVal = Builder->CreateICmpNE(Val, ConstantInt::get(*TheContext, APInt(64, 0)), "bool_cast");
+                Builder->CreateStore(BoolVal, Info->Storage);
+            } else if (TypeInfo->isString()) {
+                Value *Str = StrHandler->allocString(ConstantInt::get(*TheContext, APInt(64, 1023)), "input_str");
+                Args.push_back(ScanfStringFormatStr);
+                Args.push_back(Str);
+                Builder->CreateCall(ScanfFunc, Args);
+                StrHandler->adoptCString(Str);
+                Builder->CreateStore(Str, Info->Storage);
+                releaseString(Info);
+            } else if (TypeInfo->isChar()) {
+                Value *CharFmt = Builder->CreateGlobalStringPtr(" %c", "fmt_in_char", 0, TheModule.get());
+                Args.push_back(CharFmt);
+                Args.push_back(Info->Storage);
+                Builder->CreateCall(ScanfFunc, Args);
+            } else {
+                Args.push_back(ScanfFormatStr);
+                Args.push_back(Info->Storage);
+                Builder->CreateCall(ScanfFunc, Args);
+            }
             return;
         }
-
-        std::vector<Value*> Args;
-        if (TypeInfo->isReal()) {
-            Args.push_back(ScanfFloatFormatStr);
-            Args.push_back(Info->Storage);
-            Builder->CreateCall(ScanfFunc, Args);
-        } else if (TypeInfo->isBoolean()) {
-            AllocaInst *TempInt = CreateEntryBlockAlloca(Builder->GetInsertBlock()->getParent(), "tmp_bool_input");
-            Args.push_back(ScanfFormatStr);
-            Args.push_back(TempInt);
-            Builder->CreateCall(ScanfFunc, Args);
-
-            Value *Val = Builder->CreateLoad(Type::getInt64Ty(*TheContext), TempInt);
-            Value *BoolVal = Builder->CreateICmpNE(Val, ConstantInt::get(*TheContext, APInt(64, 0)), "bool_cast");
-            Builder->CreateStore(BoolVal, Info->Storage);
-        } else if (TypeInfo->isString()) {
-            Function *MallocF = TheModule->getFunction("malloc");
-            Value *Mem = Builder->CreateCall(MallocF, ConstantInt::get(*TheContext, APInt(64, 1024)), "input_str");
-            Args.push_back(ScanfStringFormatStr);
-            Args.push_back(Mem);
-            Builder->CreateCall(ScanfFunc, Args);
-            Builder->CreateStore(Mem, Info->Storage);
-        } else if (TypeInfo->isChar()) {
-            Value *CharFmt = Builder->CreateGlobalStringPtr(" %c", "fmt_in_char", 0, TheModule.get());
-            Args.push_back(CharFmt);
-            Args.push_back(Info->Storage);
-            Builder->CreateCall(ScanfFunc, Args);
-        } else {
-            Args.push_back(ScanfFormatStr);
-            Args.push_back(Info->Storage);
-            Builder->CreateCall(ScanfFunc, Args);
+        case StmtAST::SK_Output: {
+            auto *Out = cast<OutputStmtAST>(Stmt);
+            bool Handled = Arrays->tryEmitArrayOutput(Out->getExpr(), *this);
+            if (Handled) return;
+
+            Value *Val = emitExpr(Out->getExpr());
+            const TypeInfo *TypeInfo = Out->getExpr()->getType();
+            if (!TypeInfo) TypeInfo = resolveType("INTEGER");
+            emitOutputValue(Val, TypeInfo, true);
+            return;
         }
-        return;
-    }
-
-    if (auto *Out = dynamic_cast<OutputStmtAST*>(Stmt)) {
-        bool Handled = Arrays->tryEmitArrayOutput(Out->getExpr(), *this);
-        if (Handled) return;
-
-        Value *Val = emitExpr(Out->getExpr());
-        const TypeInfo *TypeInfo = getExprTypeInfo(Out->getExpr());
-        if (!TypeInfo) TypeInfo = resolveType("INTEGER");
-        emitOutputValue(Val, TypeInfo, true);
-        return;
-    }
-
-    if (auto *IfStmt = dynamic_cast<IfStmtAST*>(Stmt)) {
-        emitIfStmt(IfStmt);
-        return;
-    }
-    if (auto *WhileStmt = dynamic_cast<WhileStmtAST*>(Stmt)) {
-        emitWhileStmt(WhileStmt);
-        return;
-    }
-    if (auto *RepeatStmt = dynamic_cast<RepeatStmtAST*>(Stmt)) {
-        emitRepeatStmt(RepeatStmt);
-        return;
-    }
-    if (auto *ForStmt = dynamic_cast<ForStmtAST*>(Stmt)) {
-        emitForStmt(ForStmt);
-        return;
+        case StmtAST::SK_If:
+            emitIfStmt(cast<IfStmtAST>(Stmt));
+            return;
+        case StmtAST::SK_While:
+            emitWhileStmt(cast<WhileStmtAST>(Stmt));
+            return;
+        case StmtAST::SK_Repeat:
+            emitRepeatStmt(cast<RepeatStmtAST>(Stmt));
+            return;
+        case StmtAST::SK_For:
+            emitForStmt(cast<ForStmtAST>(Stmt));
+            return;
     }
 }
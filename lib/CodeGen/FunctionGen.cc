@@ -1,6 +1,5 @@
 #include "cps/FunctionGen.h"
 #include "llvm/IR/Verifier.h"
-#include <cstdio>
 
 using namespace llvm;
 using namespace cps;
@@ -8,25 +7,25 @@ using namespace cps;
 Type *FunctionGen::getLLVMType(const std::string &TypeName) {
     Type *Resolved = Types.getLLVMType(TypeName);
     if (!Resolved) {
-        fprintf(stderr, "Error: Unknown type %s\n", TypeName.c_str());
+        Diags.error("Unknown type %s", TypeName.c_str());
         return Type::getInt64Ty(Context);
     }
     return Resolved;
 }
 
-void FunctionGen::createArgumentAllocas(Function *F, const std::vector<std::tuple<std::string, std::string, bool>> &Args) {
+void FunctionGen::createArgumentAllocas(Function *F, ArrayRef<std::tuple<SymbolID, StringRef, bool>> Args) {
     Function::arg_iterator AI = F->arg_begin();
     for (unsigned Idx = 0, E = Args.size(); Idx != E; ++Idx, ++AI) {
-        std::string ArgName = std::get<0>(Args[Idx]);
-        std::string ArgTypeStr = std::get<1>(Args[Idx]);
+        SymbolID ArgID = std::get<0>(Args[Idx]);
+        StringRef ArgName = Names.get(ArgID);
+        std::string ArgTypeStr = std::get<1>(Args[Idx]).str();
         bool IsRef = std::get<2>(Args[Idx]);
 
         Value *ArgVal = &(*AI);
         ArgVal->setName(ArgName);
 
         if (IsRef) {
-            NamedValues[ArgName] = ArgVal;
-            Symbols[ArgName] = {ArgVal, ArgTypeStr, false};
+            Symbols.declare(ArgID, {ArgVal, Types.resolve(ArgTypeStr), false});
             continue;
         }
 
@@ -35,32 +34,38 @@ void FunctionGen::createArgumentAllocas(Function *F, const std::vector<std::tupl
         AllocaInst *Alloca = TmpB.CreateAlloca(ArgType, nullptr, ArgName);
 
         Builder.CreateStore(ArgVal, Alloca);
-        NamedValues[ArgName] = Alloca;
-        Symbols[ArgName] = {Alloca, ArgTypeStr, false};
+        Symbols.declare(ArgID, {Alloca, Types.resolve(ArgTypeStr), false});
     }
 }
 
+Function *FunctionGen::getFunction(SymbolID Name) const {
+    if (Name < Functions.size() && Functions[Name]) return Functions[Name];
+    return Module.getFunction(Names.get(Name));
+}
+
 Function *FunctionGen::emitPrototype(PrototypeAST *Proto) {
     std::vector<Type*> ArgTypes;
     for (const auto &Arg : Proto->getArgs()) {
-        Type *T = getLLVMType(std::get<1>(Arg));
+        Type *T = getLLVMType(std::get<1>(Arg).str());
         if (std::get<2>(Arg)) {
             T = T->getPointerTo();
         }
         ArgTypes.push_back(T);
     }
 
-    Type *RetType = getLLVMType(Proto->getReturnType());
+    Type *RetType = getLLVMType(Proto->getReturnType().str());
     FunctionType *FT = FunctionType::get(RetType, ArgTypes, false);
-    Function *F = Module.getFunction(Proto->getName());
+    Function *F = getFunction(Proto->getNameID());
     if (!F) {
-        F = Function::Create(FT, Function::ExternalLinkage, Proto->getName(), &Module);
+        F = Function::Create(FT, Function::ExternalLinkage, Names.get(Proto->getNameID()), &Module);
     }
+    if (Functions.size() <= Proto->getNameID()) Functions.resize(Names.size());
+    Functions[Proto->getNameID()] = F;
 
     unsigned Idx = 0;
     for (auto &Arg : F->args()) {
         if (Idx < Proto->getArgs().size()) {
-            Arg.setName(std::get<0>(Proto->getArgs()[Idx++]));
+            Arg.setName(Names.get(std::get<0>(Proto->getArgs()[Idx++])));
         }
     }
     return F;
@@ -69,7 +74,7 @@ Function *FunctionGen::emitPrototype(PrototypeAST *Proto) {
 Function *FunctionGen::emitFunctionDef(FunctionDefAST *FuncAST,
                                        const std::function<void(StmtAST*)> &StmtEmitter) {
     PrototypeAST *Proto = FuncAST->getProto();
-    Function *TheFunction = Module.getFunction(Proto->getName());
+    Function *TheFunction = getFunction(Proto->getNameID());
 
     if (!TheFunction) {
         TheFunction = emitPrototype(Proto);
@@ -77,22 +82,18 @@ Function *FunctionGen::emitFunctionDef(FunctionDefAST *FuncAST,
 
     if (!TheFunction) return nullptr;
     if (!TheFunction->empty()) {
-        fprintf(stderr, "Error: Function %s cannot be redefined.\n", Proto->getName().c_str());
+        Diags.error("Function %s cannot be redefined.", Names.get(Proto->getNameID()).data());
         return nullptr;
     }
 
     BasicBlock *BB = BasicBlock::Create(Context, "entry", TheFunction);
     Builder.SetInsertPoint(BB);
 
-    std::map<std::string, llvm::Value*> OldNamedValues = NamedValues;
-    std::map<std::string, SymbolInfo> OldSymbols = Symbols;
-    NamedValues.clear();
-    Symbols.clear();
-
+    Symbols.enterFunctionScope();
     createArgumentAllocas(TheFunction, Proto->getArgs());
 
-    for (const auto &Stmt : FuncAST->getBody()) {
-        StmtEmitter(Stmt.get());
+    for (StmtAST *Stmt : FuncAST->getBody()) {
+        StmtEmitter(Stmt);
     }
 
     if (!Builder.GetInsertBlock()->getTerminator()) {
@@ -103,18 +104,21 @@ Function *FunctionGen::emitFunctionDef(FunctionDefAST *FuncAST,
         }
     }
 
-    verifyFunction(*TheFunction);
-    NamedValues = OldNamedValues;
-    Symbols = OldSymbols;
+    {
+        TimeReport::Scope Verifying(Timer, "verify");
+        verifyFunction(*TheFunction);
+    }
+    Symbols.leaveScope();
     return TheFunction;
 }
 
 static Value *GenerateCall(llvm::Module &Module,
                            llvm::IRBuilder<> &Builder,
                            llvm::LLVMContext &Context,
-                           const std::string &CalleeName,
+                           DiagnosticEngine &Diags,
+                           Function *CalleeF,
+                           StringRef CalleeName,
                            const std::vector<llvm::Value*> &Args) {
-    Function *CalleeF = Module.getFunction(CalleeName);
     if (!CalleeF) {
         std::vector<Type*> ArgTypes;
         for (auto *Val : Args) ArgTypes.push_back(Val->getType());
@@ -123,7 +127,7 @@ static Value *GenerateCall(llvm::Module &Module,
     }
 
     if (CalleeF->arg_size() != Args.size()) {
-        fprintf(stderr, "Error: Incorrect # arguments passed to %s\n", CalleeName.c_str());
+        Diags.error("Incorrect # arguments passed to %s", CalleeName.data());
         return nullptr;
     }
 
@@ -135,11 +139,11 @@ static Value *GenerateCall(llvm::Module &Module,
 }
 
 llvm::Value *FunctionGen::emitCallExpr(CallExprAST *Call, const std::vector<llvm::Value*> &Args) {
-    return GenerateCall(Module, Builder, Context, Call->getCallee(), Args);
+    return GenerateCall(Module, Builder, Context, Diags, getFunction(Call->getCalleeID()), Names.get(Call->getCalleeID()), Args);
 }
 
 void FunctionGen::emitCallStmt(CallStmtAST *Call, const std::vector<llvm::Value*> &Args) {
-    GenerateCall(Module, Builder, Context, Call->getCallee(), Args);
+    GenerateCall(Module, Builder, Context, Diags, getFunction(Call->getCalleeID()), Names.get(Call->getCalleeID()), Args);
 }
 
 void FunctionGen::emitReturn(ReturnStmtAST *Ret, llvm::Value *RetVal) {
@@ -0,0 +1,172 @@
+#include "cps/ObjectEmitter.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetOptions.h"
+#if LLVM_VERSION_MAJOR >= 17
+#include "llvm/TargetParser/Host.h"
+#else
+#include "llvm/Support/Host.h"
+#endif
+#include <cstdio>
+#include <vector>
+
+using namespace llvm;
+using namespace cps;
+
+#if LLVM_VERSION_MAJOR >= 18
+static CodeGenOptLevel getCodeGenOptLevel(unsigned Level) {
+    return Level == 0 ? CodeGenOptLevel::None : CodeGenOptLevel::Default;
+}
+static const CodeGenFileType ObjectFileType = CodeGenFileType::ObjectFile;
+#else
+static CodeGenOpt::Level getCodeGenOptLevel(unsigned Level) {
+    return Level == 0 ? CodeGenOpt::None : CodeGenOpt::Default;
+}
+static const CodeGenFileType ObjectFileType = CGFT_ObjectFile;
+#endif
+
+ObjectEmitter::~ObjectEmitter() = default;
+
+void ObjectEmitter::initializeNativeTarget() {
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+    InitializeNativeTargetAsmParser();
+}
+
+ObjectEmitter::ObjectEmitter(unsigned OptLevel) {
+    initializeNativeTarget();
+
+    TargetTriple = sys::getDefaultTargetTriple();
+    std::string Error;
+    const Target *TheTarget = TargetRegistry::lookupTarget(TargetTriple, Error);
+    if (!TheTarget) {
+        fprintf(stderr, "Error: %s\n", Error.c_str());
+        return;
+    }
+
+    TargetOptions Opts;
+    TM.reset(TheTarget->createTargetMachine(TargetTriple,
+                                            sys::getHostCPUName(),
+                                            "",
+                                            Opts,
+                                            Reloc::PIC_,
+                                            CodeModel::Small,
+                                            getCodeGenOptLevel(OptLevel)));
+    if (!TM) {
+        fprintf(stderr, "Error: Cannot create target machine for %s\n", TargetTriple.c_str());
+    }
+}
+
+void ObjectEmitter::configureModule(Module &M) {
+    if (!TM) return;
+    M.setTargetTriple(TargetTriple);
+    M.setDataLayout(TM->createDataLayout());
+}
+
+bool ObjectEmitter::emitObject(Module &M, SmallVectorImpl<char> &Buffer) {
+    if (!TM) return false;
+    configureModule(M);
+
+    raw_svector_ostream Dest(Buffer);
+    legacy::PassManager PM;
+    if (TM->addPassesToEmitFile(PM, Dest, nullptr, ObjectFileType)) {
+        fprintf(stderr, "Error: Target cannot emit an object file\n");
+        return false;
+    }
+
+    PM.run(M);
+    return true;
+}
+
+bool ObjectEmitter::emitObjectFile(Module &M, const std::string &Path) {
+    SmallVector<char, 0> Buffer;
+    return emitObject(M, Buffer) && writeFile(Path, Buffer);
+}
+
+bool ObjectEmitter::writeFile(const std::string &Path, ArrayRef<char> Data) {
+    std::error_code EC;
+    raw_fd_ostream Dest(Path, EC, sys::fs::OF_None);
+    if (EC) {
+        fprintf(stderr, "Error: Cannot open %s: %s\n", Path.c_str(), EC.message().c_str());
+        return false;
+    }
+
+    Dest.write(Data.data(), Data.size());
+    Dest.close();
+    if (Dest.has_error()) {
+        fprintf(stderr, "Error: Cannot write %s\n", Path.c_str());
+        Dest.clear_error();
+        return false;
+    }
+    return true;
+}
+
+// Runs the system C compiler as a linker on Inputs, writing OutputPath.
+static bool runLinker(ArrayRef<StringRef> Flags, ArrayRef<std::string> Inputs, const std::string &OutputPath) {
+    auto CC = sys::findProgramByName("cc");
+    if (!CC) {
+        fprintf(stderr, "Error: Cannot find a system C compiler (cc) to link with\n");
+        return false;
+    }
+
+    SmallVector<StringRef, 8> Args = {*CC};
+    Args.append(Flags.begin(), Flags.end());
+    Args.append(Inputs.begin(), Inputs.end());
+    Args.append({"-o", OutputPath});
+    std::string ErrMsg;
+    int Result = sys::ExecuteAndWait(*CC, Args, {}, {}, 0, 0, &ErrMsg);
+    if (Result != 0) {
+        fprintf(stderr, "Error: Linking %s failed%s%s\n",
+                OutputPath.c_str(),
+                ErrMsg.empty() ? "" : ": ",
+                ErrMsg.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ObjectEmitter::linkExecutable(const std::string &ObjectPath, const std::string &OutputPath) {
+    return runLinker({}, ObjectPath, OutputPath);
+}
+
+bool ObjectEmitter::combineObjects(ArrayRef<SmallVector<char, 0>> Objects, SmallVectorImpl<char> &Combined) {
+    std::vector<std::string> Paths;
+    auto RemoveAll = [&Paths] {
+        for (const std::string &Path : Paths) sys::fs::remove(Path);
+    };
+
+    // The partial link's output comes first, the inputs after it.
+    for (size_t i = 0; i <= Objects.size(); ++i) {
+        SmallString<128> Path;
+        if (sys::fs::createTemporaryFile("cps", "o", Path)) {
+            fprintf(stderr, "Error: Cannot create temporary object file\n");
+            RemoveAll();
+            return false;
+        }
+        Paths.push_back(Path.str().str());
+        if (i > 0 && !writeFile(Paths.back(), Objects[i - 1])) {
+            RemoveAll();
+            return false;
+        }
+    }
+
+    bool Ok = runLinker({"-r"}, ArrayRef<std::string>(Paths).drop_front(), Paths.front());
+    if (Ok) {
+        auto Buffer = MemoryBuffer::getFile(Paths.front(), /*IsText=*/false, /*RequiresNullTerminator=*/false);
+        if (Buffer) {
+            Combined.assign((*Buffer)->getBufferStart(), (*Buffer)->getBufferEnd());
+        } else {
+            fprintf(stderr, "Error: Cannot read %s: %s\n", Paths.front().c_str(), Buffer.getError().message().c_str());
+            Ok = false;
+        }
+    }
+    RemoveAll();
+    return Ok;
+}
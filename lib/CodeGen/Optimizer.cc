@@ -0,0 +1,61 @@
+#include "cps/Optimizer.h"
+#include "llvm/Analysis/CGSCCPassManager.h"
+#include "llvm/Analysis/LoopAnalysisManager.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace cps;
+
+static OptimizationLevel getPipelineLevel(unsigned Level) {
+    switch (Level) {
+        case 0: return OptimizationLevel::O0;
+        case 1: return OptimizationLevel::O1;
+        case 2: return OptimizationLevel::O2;
+        default: return OptimizationLevel::O3;
+    }
+}
+
+bool Optimizer::run(Module &M) {
+    {
+        TimeReport::Scope Verifying(Timer, "verify");
+        std::string Problems;
+        raw_string_ostream OS(Problems);
+        if (verifyModule(M, &OS)) {
+            OS.flush();
+            Diags.error("Module verification failed, skipping optimization\n%s",
+                        StringRef(Problems).rtrim().str().c_str());
+            return false;
+        }
+    }
+
+    if (OptLevel == 0) return true;
+
+    TimeReport::Scope Optimizing(Timer, "optimize");
+
+    // Keep a layout the caller already chose, e.g. the JIT's.
+    if (TM) {
+        if (M.getTargetTriple().empty()) M.setTargetTriple(TM->getTargetTriple().str());
+        if (M.getDataLayoutStr().empty()) M.setDataLayout(TM->createDataLayout());
+    }
+
+    LoopAnalysisManager LAM;
+    FunctionAnalysisManager FAM;
+    CGSCCAnalysisManager CGAM;
+    ModuleAnalysisManager MAM;
+
+    PassBuilder PB(TM);
+    if (TM) FAM.registerPass([this] { return TM->getTargetIRAnalysis(); });
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+    ModulePassManager MPM = PB.buildPerModuleDefaultPipeline(getPipelineLevel(OptLevel));
+    MPM.run(M, MAM);
+    return true;
+}
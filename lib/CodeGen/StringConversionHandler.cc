@@ -3,8 +3,8 @@
 using namespace llvm;
 using namespace cps;
 
-StringConversionHandler::StringConversionHandler(LLVMContext &Ctx, IRBuilder<> &B, llvm::Module &M)
-    : Context(Ctx), Builder(B), Module(M) {
+StringConversionHandler::StringConversionHandler(LLVMContext &Ctx, IRBuilder<> &B, llvm::Module &M, StringHandler &S)
+    : Context(Ctx), Builder(B), Module(M), Strings(S) {
     setupExternalFunctions();
 }
 
@@ -17,14 +17,11 @@ void StringConversionHandler::setupExternalFunctions() {
 
     FunctionType *StrtodType = FunctionType::get(Type::getDoubleTy(Context), {PointerType::getUnqual(Context), PointerType::getUnqual(Context)}, false);
     StrtodFunc = Module.getOrInsertFunction("strtod", StrtodType);
-
-    FunctionType *MallocType = FunctionType::get(PointerType::getUnqual(Context), {Type::getInt64Ty(Context)}, false);
-    MallocFunc = Module.getOrInsertFunction("malloc", MallocType);
 }
 
 Value *StringConversionHandler::emitNumToStr(Value *Num, bool IsReal) {
-    Value *AllocSize = ConstantInt::get(Type::getInt64Ty(Context), 64);
-    Value *Buffer = Builder.CreateCall(MallocFunc, AllocSize, "num_str_buf");
+    Value *Capacity = ConstantInt::get(Type::getInt64Ty(Context), 63);
+    Value *Buffer = Strings.allocString(Capacity, "num_str_buf");
 
     Value *FormatStr;
     if (IsReal) {
@@ -33,7 +30,8 @@ Value *StringConversionHandler::emitNumToStr(Value *Num, bool IsReal) {
         FormatStr = Builder.CreateGlobalStringPtr("%d");
     }
 
-    Builder.CreateCall(SprintfFunc, {Buffer, FormatStr, Num});
+    Value *Written = Builder.CreateCall(SprintfFunc, {Buffer, FormatStr, Num}, "num_str_len");
+    Strings.storeLength(Buffer, Builder.CreateSExt(Written, Type::getInt64Ty(Context)));
     return Buffer;
 }
 
@@ -56,9 +54,7 @@ Value *StringConversionHandler::emitIsNum(Value *Str) {
     Builder.CreateCall(StrtodFunc, {Str, EndPtrAlloc});
     Value *EndPtrVal = Builder.CreateLoad(PointerType::getUnqual(Context), EndPtrAlloc, "endptr_val");
     
-    FunctionType *StrLenType = FunctionType::get(Type::getInt64Ty(Context), {PointerType::getUnqual(Context)}, false);
-    FunctionCallee StrLenFunc = Module.getOrInsertFunction("strlen", StrLenType);
-    Value *Len = Builder.CreateCall(StrLenFunc, Str, "str_len");
+    Value *Len = Strings.emitLength(Str);
     
     Value *ExpectedEndPtr = Builder.CreateInBoundsGEP(Type::getInt8Ty(Context), Str, Len);
     
@@ -2,13 +2,13 @@
 #include "llvm/IR/Type.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/ADT/SmallVector.h"
 
 using namespace llvm;
 using namespace cps;
 
-StringHandler::StringHandler(LLVMContext &Ctx, IRBuilder<> &B, llvm::Module &M, 
-                             std::map<std::string, Value*> &NV)
-    : Context(Ctx), Builder(B), Module(M), NamedValues(NV) {
+StringHandler::StringHandler(LLVMContext &Ctx, IRBuilder<> &B, llvm::Module &M)
+    : Context(Ctx), Builder(B), Module(M) {
     setupExternalFunctions();
 }
 
@@ -31,23 +31,132 @@ void StringHandler::setupExternalFunctions() {
     ToLowerFunc = Module.getOrInsertFunction("tolower", CharCaseType);
 }
 
-void StringHandler::emitDeclare(const std::string &Name) {
-    Function *TheFunction = Builder.GetInsertBlock()->getParent();
-    IRBuilder<> TmpB(&TheFunction->getEntryBlock(), TheFunction->getEntryBlock().begin());
-    AllocaInst *Alloca = TmpB.CreateAlloca(PointerType::getUnqual(Context), nullptr, Name);
+// Bytes in front of the characters that hold the length.
+static const uint64_t HeaderSize = 8;
+
+Value *StringHandler::createLiteral(StringRef Val, const Twine &Name) {
+    Type *Int64Ty = Type::getInt64Ty(Context);
+    Constant *Chars = ConstantDataArray::getString(Context, Val);
+    StructType *LiteralTy = StructType::get(Context, {Int64Ty, Chars->getType()});
+    Constant *Init = ConstantStruct::get(LiteralTy, {ConstantInt::get(Int64Ty, Val.size()), Chars});
+
+    auto *GV = new GlobalVariable(Module, LiteralTy, true, GlobalValue::PrivateLinkage, Init, Name);
+    GV->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+    GV->setAlignment(Align(HeaderSize));
+
+    Type *Int32Ty = Type::getInt32Ty(Context);
+    Constant *Indices[] = {ConstantInt::get(Int32Ty, 0), ConstantInt::get(Int32Ty, 1), ConstantInt::get(Int32Ty, 0)};
+    return ConstantExpr::getInBoundsGetElementPtr(LiteralTy, GV, Indices);
+}
+
+Value *StringHandler::getLengthPtr(Value *Str) {
+    Value *Offset = ConstantInt::get(Type::getInt64Ty(Context), -static_cast<int64_t>(HeaderSize));
+    Value *Header = Builder.CreateInBoundsGEP(Type::getInt8Ty(Context), Str, Offset, "len_ptr");
+    return Builder.CreateBitCast(Header, PointerType::getUnqual(Type::getInt64Ty(Context)));
+}
+
+// Room for Capacity characters and a NUL; the header is left unset.
+Value *StringHandler::allocBuffer(Value *Capacity, const Twine &Name) {
+    Value *AllocSize = Builder.CreateAdd(Capacity, ConstantInt::get(Context, APInt(64, HeaderSize + 1)));
+    Value *Mem = Builder.CreateCall(MallocFunc, AllocSize, Name + "_mem");
+    return Builder.CreateInBoundsGEP(Type::getInt8Ty(Context), Mem, ConstantInt::get(Context, APInt(64, HeaderSize)), Name);
+}
 
-    Value *EmptyStr = createLiteral("");
-    Builder.CreateStore(EmptyStr, Alloca);
-    NamedValues[Name] = Alloca;
+Value *StringHandler::allocString(Value *Len, const Twine &Name) {
+    Type *Int8Ty = Type::getInt8Ty(Context);
+    Value *Str = allocBuffer(Len, Name);
+    storeLength(Str, Len);
+    Value *NullTermPtr = Builder.CreateInBoundsGEP(Int8Ty, Str, Len);
+    Builder.CreateStore(ConstantInt::get(Int8Ty, 0), NullTermPtr);
+    return Str;
 }
 
-Value *StringHandler::createLiteral(const std::string &Val) {
-    return Builder.CreateGlobalStringPtr(Val);
+void StringHandler::storeLength(Value *Str, Value *Len) {
+    Builder.CreateAlignedStore(Len, getLengthPtr(Str), Align(HeaderSize));
+}
+
+void StringHandler::adoptCString(Value *Str) {
+    storeLength(Str, Builder.CreateCall(StrLenFunc, Str, "cstr_len"));
 }
 
 Value *StringHandler::emitLength(Value *Str) {
     if (!Str) return nullptr;
-    return Builder.CreateCall(StrLenFunc, Str, "len");
+    return Builder.CreateAlignedLoad(Type::getInt64Ty(Context), getLengthPtr(Str), Align(HeaderSize), "len");
+}
+
+Value *StringHandler::emitConcat(Value *LHS, Value *RHS) {
+    Value *LLen = emitLength(LHS);
+    Value *RLen = emitLength(RHS);
+    Value *TotalLen = Builder.CreateAdd(LLen, RLen, "totallen");
+    Value *NewStr = allocString(TotalLen, "concat_str");
+
+    Builder.CreateCall(MemCpyFunc, {NewStr, LHS, LLen});
+    Value *Tail = Builder.CreateInBoundsGEP(Type::getInt8Ty(Context), NewStr, LLen);
+    Builder.CreateCall(MemCpyFunc, {Tail, RHS, RLen});
+    return NewStr;
+}
+
+void StringHandler::emitAppend(Value *Storage, Value *Capacity, Value *Str, ArrayRef<Value *> Parts) {
+    Type *Int8Ty = Type::getInt8Ty(Context);
+    Type *Int64Ty = Type::getInt64Ty(Context);
+    Value *Zero = ConstantInt::get(Int64Ty, 0);
+
+    Value *Len = emitLength(Str);
+    SmallVector<Value *, 4> PartLens;
+    Value *NewLen = Len;
+    for (Value *Part : Parts) {
+        PartLens.push_back(emitLength(Part));
+        NewLen = Builder.CreateAdd(NewLen, PartLens.back(), "append_len");
+    }
+
+    Value *Cap = Builder.CreateLoad(Int64Ty, Capacity, "str_cap");
+    Value *Owned = Builder.CreateICmpNE(Cap, Zero, "str_owned");
+    Value *Fits = Builder.CreateAnd(Owned, Builder.CreateICmpULE(NewLen, Cap), "append_fits");
+
+    Function *TheFunction = Builder.GetInsertBlock()->getParent();
+    BasicBlock *InPlaceBB = Builder.GetInsertBlock();
+    BasicBlock *GrowBB = BasicBlock::Create(Context, "append_grow", TheFunction);
+    BasicBlock *CopyBB = BasicBlock::Create(Context, "append_copy", TheFunction);
+    Builder.CreateCondBr(Fits, CopyBB, GrowBB);
+
+    Builder.SetInsertPoint(GrowBB);
+    Value *NewCap = Builder.CreateShl(NewLen, 1, "new_cap");
+    NewCap = Builder.CreateSelect(Builder.CreateICmpULT(NewCap, ConstantInt::get(Int64Ty, 16)),
+                                  ConstantInt::get(Int64Ty, 16), NewCap);
+    Value *NewStr = allocBuffer(NewCap, "builder_str");
+    Builder.CreateCall(MemCpyFunc, {NewStr, Str, Len});
+    // Only a buffer the variable owns can be freed; anything else may be a
+    // literal or still referenced elsewhere.
+    Value *OldMem = Builder.CreateInBoundsGEP(Int8Ty, Str, ConstantInt::get(Int64Ty, -static_cast<int64_t>(HeaderSize)));
+    Value *NullPtr = ConstantPointerNull::get(cast<PointerType>(OldMem->getType()));
+    Builder.CreateCall(FreeFunc, Builder.CreateSelect(Owned, OldMem, NullPtr));
+    Builder.CreateStore(NewStr, Storage);
+    Builder.CreateStore(NewCap, Capacity);
+    Builder.CreateBr(CopyBB);
+
+    Builder.SetInsertPoint(CopyBB);
+    PHINode *Dest = Builder.CreatePHI(Str->getType(), 2, "append_dest");
+    Dest->addIncoming(Str, InPlaceBB);
+    Dest->addIncoming(NewStr, GrowBB);
+    Value *Offset = Len;
+    for (size_t i = 0; i < Parts.size(); ++i) {
+        Value *Tail = Builder.CreateInBoundsGEP(Int8Ty, Dest, Offset);
+        Builder.CreateCall(MemCpyFunc, {Tail, Parts[i], PartLens[i]});
+        Offset = Builder.CreateAdd(Offset, PartLens[i]);
+    }
+    storeLength(Dest, NewLen);
+    Builder.CreateStore(ConstantInt::get(Int8Ty, 0), Builder.CreateInBoundsGEP(Int8Ty, Dest, NewLen));
+}
+
+Value *StringHandler::emitFromChar(Value *Char) {
+    // A NUL character still ends the string, as it would for a C string.
+    Value *IsNul = Builder.CreateICmpEQ(Char, ConstantInt::get(Type::getInt8Ty(Context), 0));
+    Value *Len = Builder.CreateSelect(IsNul,
+                                      ConstantInt::get(Context, APInt(64, 0)),
+                                      ConstantInt::get(Context, APInt(64, 1)));
+    Value *Str = allocString(Len, "char_str");
+    Builder.CreateStore(Char, Str);
+    return Str;
 }
 
 Value *StringHandler::emitMid(Value *Str, Value *Start, Value *Len) {
@@ -72,18 +181,14 @@ Value *StringHandler::emitMid(Value *Str, Value *Start, Value *Len) {
     Value *IsLenNeg = Builder.CreateICmpSLT(ActualLen, Zero);
     ActualLen = Builder.CreateSelect(IsLenNeg, Zero, ActualLen);
 
-    Value *AllocSize = Builder.CreateAdd(ActualLen, One);
-    Value *NewStrMem = Builder.CreateCall(MallocFunc, AllocSize, "mid_str_mem");
+    Value *NewStr = allocString(ActualLen, "mid_str");
 
     Value *SrcPtr = Builder.CreateInBoundsGEP(Type::getInt8Ty(Context), Str, StartZeroBased);
 
-    std::vector<Value*> Args = {NewStrMem, SrcPtr, ActualLen};
+    std::vector<Value*> Args = {NewStr, SrcPtr, ActualLen};
     Builder.CreateCall(MemCpyFunc, Args);
-
-    Value *NullTermPtr = Builder.CreateInBoundsGEP(Type::getInt8Ty(Context), NewStrMem, ActualLen);
-    Builder.CreateStore(ConstantInt::get(Type::getInt8Ty(Context), 0), NullTermPtr);
     
-    return NewStrMem;
+    return NewStr;
 }
 
 Value *StringHandler::emitRight(Value *Str, Value *Len) {
@@ -97,19 +202,14 @@ Value *StringHandler::emitRight(Value *Str, Value *Len) {
 
     Value *ActualLen = Builder.CreateSub(FullLen, StartIdx);
 
-    Value *One = ConstantInt::get(Context, APInt(64, 1));
-    Value *AllocSize = Builder.CreateAdd(ActualLen, One);
-    Value *NewStrMem = Builder.CreateCall(MallocFunc, AllocSize, "right_str_mem");
+    Value *NewStr = allocString(ActualLen, "right_str");
 
     Value *SrcPtr = Builder.CreateInBoundsGEP(Type::getInt8Ty(Context), Str, StartIdx);
 
-    std::vector<Value*> Args = {NewStrMem, SrcPtr, ActualLen};
+    std::vector<Value*> Args = {NewStr, SrcPtr, ActualLen};
     Builder.CreateCall(MemCpyFunc, Args);
-
-    Value *NullTermPtr = Builder.CreateInBoundsGEP(Type::getInt8Ty(Context), NewStrMem, ActualLen);
-    Builder.CreateStore(ConstantInt::get(Type::getInt8Ty(Context), 0), NullTermPtr);
     
-    return NewStrMem;
+    return NewStr;
 }
 
 Value *StringHandler::emitLeft(Value *Str, Value *Len) {
@@ -128,24 +228,18 @@ Value *StringHandler::emitLeft(Value *Str, Value *Len) {
     Value *IsTooBig = Builder.CreateICmpSGT(SafeLen, FullLen);
     Value *ActualLen = Builder.CreateSelect(IsTooBig, FullLen, SafeLen);
 
-    Value *One = ConstantInt::get(Context, APInt(64, 1));
-    Value *AllocSize = Builder.CreateAdd(ActualLen, One);
-    Value *NewStrMem = Builder.CreateCall(MallocFunc, AllocSize, "left_str_mem");
+    Value *NewStr = allocString(ActualLen, "left_str");
 
-    std::vector<Value*> Args = {NewStrMem, Str, ActualLen};
+    std::vector<Value*> Args = {NewStr, Str, ActualLen};
     Builder.CreateCall(MemCpyFunc, Args);
 
-    Value *NullTermPtr = Builder.CreateInBoundsGEP(Type::getInt8Ty(Context), NewStrMem, ActualLen);
-    Builder.CreateStore(ConstantInt::get(Type::getInt8Ty(Context), 0), NullTermPtr);
-
-    return NewStrMem;
+    return NewStr;
 }
 
-Value *StringHandler::emitLCase(Value *Str) {
+Value *StringHandler::emitCaseMap(Value *Str, FunctionCallee MapFunc, const Twine &Name) {
     Value *Len = emitLength(Str);
     Value *One = ConstantInt::get(Context, APInt(64, 1));
-    Value *AllocSize = Builder.CreateAdd(Len, One);
-    Value *NewStr = Builder.CreateCall(MallocFunc, AllocSize, "lcase_str");
+    Value *NewStr = allocString(Len, Name);
 
     Function *TheFunction = Builder.GetInsertBlock()->getParent();
     BasicBlock *LoopBB = BasicBlock::Create(Context, "loop", TheFunction);
@@ -170,8 +264,8 @@ Value *StringHandler::emitLCase(Value *Str) {
     Value *CharVal = Builder.CreateLoad(Type::getInt8Ty(Context), SrcPtr);
 
     Value *ExtChar = Builder.CreateSExt(CharVal, Type::getInt32Ty(Context));
-    Value *LowerChar = Builder.CreateCall(ToLowerFunc, ExtChar);
-    Value *TruncChar = Builder.CreateTrunc(LowerChar, Type::getInt8Ty(Context));
+    Value *MappedChar = Builder.CreateCall(MapFunc, ExtChar);
+    Value *TruncChar = Builder.CreateTrunc(MappedChar, Type::getInt8Ty(Context));
 
     Value *DestPtr = Builder.CreateInBoundsGEP(Type::getInt8Ty(Context), NewStr, CurIdx);
     Builder.CreateStore(TruncChar, DestPtr);
@@ -181,58 +275,13 @@ Value *StringHandler::emitLCase(Value *Str) {
     Builder.CreateBr(LoopBB);
     
     Builder.SetInsertPoint(AfterBB);
-
-    Value *NullPtr = Builder.CreateInBoundsGEP(Type::getInt8Ty(Context), NewStr, Len);
-    Builder.CreateStore(ConstantInt::get(Type::getInt8Ty(Context), 0), NullPtr);
-    
     return NewStr;
 }
 
-Value *StringHandler::emitUCase(Value *Str) {
-    Value *Len = emitLength(Str);
-    Value *One = ConstantInt::get(Context, APInt(64, 1));
-    Value *AllocSize = Builder.CreateAdd(Len, One);
-    Value *NewStr = Builder.CreateCall(MallocFunc, AllocSize, "ucase_str");
-    
-    // Loop
-    Function *TheFunction = Builder.GetInsertBlock()->getParent();
-    BasicBlock *LoopBB = BasicBlock::Create(Context, "loop", TheFunction);
-    BasicBlock *AfterBB = BasicBlock::Create(Context, "afterloop", TheFunction);
-    
-    // Init i = 0
-    IRBuilder<> TmpB(&TheFunction->getEntryBlock(), TheFunction->getEntryBlock().begin());
-    AllocaInst *IdxVar = TmpB.CreateAlloca(Type::getInt64Ty(Context), nullptr, "idx");
-    Builder.CreateStore(ConstantInt::get(Context, APInt(64, 0)), IdxVar);
-    
-    Builder.CreateBr(LoopBB);
-    Builder.SetInsertPoint(LoopBB);
-    
-    Value *CurIdx = Builder.CreateLoad(Type::getInt64Ty(Context), IdxVar);
-    Value *Cond = Builder.CreateICmpSLT(CurIdx, Len);
-    
-    BasicBlock *BodyBB = BasicBlock::Create(Context, "body", TheFunction);
-    Builder.CreateCondBr(Cond, BodyBB, AfterBB);
-    
-    Builder.SetInsertPoint(BodyBB);
-
-    Value *SrcPtr = Builder.CreateInBoundsGEP(Type::getInt8Ty(Context), Str, CurIdx);
-    Value *CharVal = Builder.CreateLoad(Type::getInt8Ty(Context), SrcPtr);
-
-    Value *ExtChar = Builder.CreateSExt(CharVal, Type::getInt32Ty(Context));
-    Value *UpperChar = Builder.CreateCall(ToUpperFunc, ExtChar);
-    Value *TruncChar = Builder.CreateTrunc(UpperChar, Type::getInt8Ty(Context));
-
-    Value *DestPtr = Builder.CreateInBoundsGEP(Type::getInt8Ty(Context), NewStr, CurIdx);
-    Builder.CreateStore(TruncChar, DestPtr);
-
-    Value *NextIdx = Builder.CreateAdd(CurIdx, One);
-    Builder.CreateStore(NextIdx, IdxVar);
-    Builder.CreateBr(LoopBB);
-    
-    Builder.SetInsertPoint(AfterBB);
+Value *StringHandler::emitLCase(Value *Str) {
+    return emitCaseMap(Str, ToLowerFunc, "lcase_str");
+}
 
-    Value *NullPtr = Builder.CreateInBoundsGEP(Type::getInt8Ty(Context), NewStr, Len);
-    Builder.CreateStore(ConstantInt::get(Type::getInt8Ty(Context), 0), NullPtr);
-    
-    return NewStr;
+Value *StringHandler::emitUCase(Value *Str) {
+    return emitCaseMap(Str, ToUpperFunc, "ucase_str");
 }
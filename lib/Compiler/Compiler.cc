@@ -0,0 +1,146 @@
+#include "cps/Compiler.h"
+#include "cps/CodeGen.h"
+#include "cps/Lexer.h"
+#include "cps/ObjectEmitter.h"
+#include "cps/Optimizer.h"
+#include "cps/Parser.h"
+#include "cps/Sema.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace cps;
+
+// Splits M into Opts.CodeGenThreads parts and optimizes and emits each on
+// its own thread, then partially links the objects into Object. A context
+// must only be used by one thread at a time, so every part is handed over
+// as bitcode and read back into a context of its own. Emitter serves the
+// calling thread; the others create their own.
+static bool emitSplit(llvm::Module &M, ObjectEmitter &Emitter, const CompileOptions &Opts,
+                      DiagnosticEngine &Diags, llvm::SmallVectorImpl<char> &Object) {
+    std::vector<llvm::SmallVector<char, 0>> Parts;
+    {
+        TimeReport::Scope Splitting(Opts.Timer, "split");
+        llvm::SplitModule(M, Opts.CodeGenThreads, [&Parts](std::unique_ptr<llvm::Module> Part) {
+            Parts.emplace_back();
+            llvm::raw_svector_ostream OS(Parts.back());
+            llvm::WriteBitcodeToFile(*Part, OS);
+        });
+    }
+
+    TimeReport::Scope Emitting(Opts.Timer, "emit");
+    std::vector<llvm::SmallVector<char, 0>> Objects(Parts.size());
+    std::vector<char> Emitted(Parts.size(), false);
+    std::atomic<size_t> Next(0);
+
+    auto Worker = [&](ObjectEmitter &PartEmitter) {
+        for (size_t i = Next++; i < Parts.size(); i = Next++) {
+            llvm::LLVMContext Ctx;
+            llvm::MemoryBufferRef Buffer(llvm::StringRef(Parts[i].data(), Parts[i].size()), "part");
+            auto Part = llvm::parseBitcodeFile(Buffer, Ctx);
+            if (!Part) {
+                Diags.error("Cannot read split module: %s", llvm::toString(Part.takeError()).c_str());
+                continue;
+            }
+            PartEmitter.configureModule(**Part);
+            Emitted[i] = Optimizer(Opts.OptLevel, Diags, PartEmitter.getTargetMachine()).run(**Part) &&
+                         PartEmitter.emitObject(**Part, Objects[i]);
+        }
+    };
+
+    std::vector<std::thread> Threads;
+    for (size_t i = 1; i < Parts.size(); ++i) {
+        Threads.emplace_back([&] {
+            // One TargetMachine per thread; they are not safe to share.
+            ObjectEmitter PartEmitter(Opts.OptLevel);
+            if (PartEmitter.isValid()) Worker(PartEmitter);
+        });
+    }
+    Worker(Emitter);
+    for (auto &T : Threads) T.join();
+
+    for (char Ok : Emitted) {
+        if (!Ok) return false;
+    }
+    return ObjectEmitter::combineObjects(Objects, Object);
+}
+
+CompileResult cps::compile(std::string_view Source, const CompileOptions &Opts) {
+    CompileResult Result;
+
+    Interner Names;
+    DiagnosticEngine Diags(Opts.OnError);
+    CodeGen CG(Names, Diags);
+    CG.setTimeReport(Opts.Timer);
+    {
+        // Each top-level statement is parsed, checked and lowered before the
+        // next is parsed, and its tree freed, so the AST never holds more
+        // than one statement (or FUNCTION) however long the program is. The
+        // tokens are dropped before optimization.
+        TokenStream Tokens;
+        {
+            TimeReport::Scope Lexing(Opts.Timer, "lex");
+            Tokens = lexBuffer(Source, Names, Diags);
+        }
+
+        size_t ParsePhase = Opts.Timer ? Opts.Timer->getPhase("parse") : 0;
+        size_t SemaPhase = Opts.Timer ? Opts.Timer->getPhase("sema") : 0;
+
+        ASTContext AST;
+        Parser P(Tokens, Names, AST, Diags);
+        Sema S(Names, CG.getTypes(), Diags);
+        CG.beginMain();
+        while (true) {
+            StmtAST *Stmt;
+            {
+                TimeReport::Scope Parsing(Opts.Timer, ParsePhase);
+                Stmt = P.ParseNext();
+            }
+            if (!Stmt) break;
+            {
+                TimeReport::Scope Checking(Opts.Timer, SemaPhase);
+                S.check(Stmt);
+            }
+            CG.emitTopLevel(Stmt);
+            AST.reset();
+        }
+        CG.finishMain();
+    }
+    Result.NumErrors = Diags.getNumErrors();
+
+    if (Opts.Output == CompileOutput::Object && Result.NumErrors == 0) {
+        std::unique_ptr<ObjectEmitter> OwnedEmitter;
+        ObjectEmitter *Emitter = Opts.Emitter;
+        if (!Emitter) {
+            OwnedEmitter = std::make_unique<ObjectEmitter>(Opts.OptLevel);
+            Emitter = OwnedEmitter.get();
+        }
+
+        if (Emitter->isValid()) {
+            Emitter->configureModule(CG.getModule());
+            if (Opts.CodeGenThreads > 1) {
+                // Only verified as a whole; each part is optimized on its own.
+                if (CG.optimize(0)) Result.Ok = emitSplit(CG.getModule(), *Emitter, Opts, Diags, Result.Object);
+            } else if (CG.optimize(Opts.OptLevel, Emitter->getTargetMachine())) {
+                TimeReport::Scope Emitting(Opts.Timer, "emit");
+                Result.Ok = Emitter->emitObject(CG.getModule(), Result.Object);
+            }
+        }
+    } else if (Opts.Output == CompileOutput::Module) {
+        if (Opts.ConfigureModule) Opts.ConfigureModule(CG.getModule());
+        // Modules run on this host, so its target drives the cost model.
+        std::unique_ptr<ObjectEmitter> Host;
+        if (Opts.OptLevel > 0) Host = std::make_unique<ObjectEmitter>(Opts.OptLevel);
+        Result.Ok = CG.optimize(Opts.OptLevel, Host ? Host->getTargetMachine() : nullptr) && Result.NumErrors == 0;
+    }
+
+    // Picks up a module the optimizer refused to verify.
+    Result.NumErrors = Diags.getNumErrors();
+    Result.Module = CG.takeModule();
+    Result.Context = CG.takeContext();
+    return Result;
+}
@@ -0,0 +1,106 @@
+#include "cps/JIT.h"
+#include "cps/ObjectEmitter.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/Orc/CompileOnDemandLayer.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/Support/Error.h"
+#include <cstdio>
+
+using namespace llvm;
+using namespace llvm::orc;
+using namespace cps;
+
+static void reportError(const char *What, Error Err) {
+    fprintf(stderr, "Error: %s: %s\n", What, toString(std::move(Err)).c_str());
+}
+
+JIT::~JIT() = default;
+
+JIT::JIT(bool Lazy) {
+    ObjectEmitter::initializeNativeTarget();
+
+    if (Lazy) {
+        auto J = LLLazyJITBuilder().create();
+        if (!J) {
+            reportError("Cannot create lazy JIT", J.takeError());
+            return;
+        }
+        // Partition at function granularity: a FUNCTION/PROCEDURE that is
+        // never called is never compiled.
+        (*J)->setPartitionFunction(CompileOnDemandLayer::compileRequested);
+        LazyJIT = J->get();
+        TheJIT = std::move(*J);
+    } else {
+        auto J = LLJITBuilder().create();
+        if (!J) {
+            reportError("Cannot create JIT", J.takeError());
+            return;
+        }
+        TheJIT = std::move(*J);
+    }
+
+    if (!addHostProcessSymbols()) {
+        LazyJIT = nullptr;
+        TheJIT.reset();
+    }
+}
+
+bool JIT::addHostProcessSymbols() {
+    // Externs declared by the handlers (printf, scanf, malloc, strlen, ...)
+    // are resolved against libc as already loaded into this process.
+    auto Generator = DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        TheJIT->getDataLayout().getGlobalPrefix());
+    if (!Generator) {
+        reportError("Cannot expose host symbols to JIT", Generator.takeError());
+        return false;
+    }
+    TheJIT->getMainJITDylib().addGenerator(std::move(*Generator));
+    return true;
+}
+
+void JIT::configureModule(Module &M) {
+    if (!TheJIT) return;
+    M.setTargetTriple(TheJIT->getTargetTriple().str());
+    M.setDataLayout(TheJIT->getDataLayout());
+}
+
+bool JIT::addModule(std::unique_ptr<Module> M, std::unique_ptr<LLVMContext> Ctx) {
+    if (!TheJIT || !M || !Ctx) return false;
+    configureModule(*M);
+
+    ThreadSafeModule TSM(std::move(M), std::move(Ctx));
+    Error Err = LazyJIT ? LazyJIT->addLazyIRModule(std::move(TSM))
+                        : TheJIT->addIRModule(std::move(TSM));
+    if (Err) {
+        reportError("Cannot add module to JIT", std::move(Err));
+        return false;
+    }
+    return true;
+}
+
+uint64_t JIT::lookupAddress(const std::string &Name) {
+    if (!TheJIT) return 0;
+
+    auto Sym = TheJIT->lookup(Name);
+    if (!Sym) {
+        reportError(("Cannot find " + Name).c_str(), Sym.takeError());
+        return 0;
+    }
+
+#if LLVM_VERSION_MAJOR >= 16
+    return Sym->getValue();
+#else
+    return Sym->getAddress();
+#endif
+}
+
+int JIT::runMain() {
+    uint64_t MainAddr = lookupAddress("main");
+    if (!MainAddr) return -1;
+
+    auto *MainFn = reinterpret_cast<int (*)()>(static_cast<uintptr_t>(MainAddr));
+    int Result = MainFn();
+    fflush(stdout);
+    return Result;
+}
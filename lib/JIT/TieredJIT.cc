@@ -0,0 +1,233 @@
+#include "cps/TieredJIT.h"
+#include "cps/Optimizer.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdio>
+
+using namespace llvm;
+using namespace llvm::orc;
+using namespace cps;
+
+#if LLVM_VERSION_MAJOR >= 17
+static ExecutorSymbolDef makeSymbol(uint64_t Addr, JITSymbolFlags Flags) {
+    return ExecutorSymbolDef(ExecutorAddr(Addr), Flags);
+}
+static ExecutorAddr toStubAddr(uint64_t Addr) { return ExecutorAddr(Addr); }
+static uint64_t getStubAddress(const ExecutorSymbolDef &Sym) { return Sym.getAddress().getValue(); }
+#else
+static JITEvaluatedSymbol makeSymbol(uint64_t Addr, JITSymbolFlags Flags) {
+    return JITEvaluatedSymbol(Addr, Flags);
+}
+static JITTargetAddress toStubAddr(uint64_t Addr) { return Addr; }
+static uint64_t getStubAddress(const JITEvaluatedSymbol &Sym) { return Sym.getAddress(); }
+#endif
+
+static const char *TierUpName = "__cps_tier_up";
+
+static void tierUpTrampoline(void *Self, uint64_t Id) {
+    static_cast<TieredJIT*>(Self)->requestPromotion(Id);
+}
+
+static bool reportIfError(const char *What, Error Err) {
+    if (!Err) return false;
+    fprintf(stderr, "Error: %s: %s\n", What, toString(std::move(Err)).c_str());
+    return true;
+}
+
+TieredJIT::TieredJIT(uint64_t Threshold) : Threshold(Threshold) {
+    if (!BaseJIT.isValid()) return;
+
+    auto JTMB = JITTargetMachineBuilder::detectHost();
+    if (!JTMB) {
+        reportIfError("Cannot detect host target", JTMB.takeError());
+        return;
+    }
+    auto TM = JTMB->createTargetMachine();
+    if (!TM) {
+        reportIfError("Cannot create host target machine", TM.takeError());
+        return;
+    }
+    HostTM = std::move(*TM);
+}
+
+TieredJIT::~TieredJIT() {
+    {
+        std::lock_guard<std::mutex> Lock(QueueMutex);
+        Stopping = true;
+    }
+    QueueCV.notify_all();
+    if (Worker.joinable()) Worker.join();
+}
+
+bool TieredJIT::instrumentTier0(Module &M) {
+    LLVMContext &Ctx = M.getContext();
+    Type *Int64Ty = Type::getInt64Ty(Ctx);
+    PointerType *PtrTy = PointerType::getUnqual(Ctx);
+
+    FunctionType *TierUpTy = FunctionType::get(Type::getVoidTy(Ctx), {PtrTy, Int64Ty}, false);
+    FunctionCallee TierUp = M.getOrInsertFunction(TierUpName, TierUpTy);
+    Constant *SelfPtr = ConstantExpr::getIntToPtr(
+        ConstantInt::get(Int64Ty, reinterpret_cast<uintptr_t>(this)), PtrTy);
+
+    for (uint64_t Id = 0; Id < TieredNames.size(); ++Id) {
+        const std::string &Name = TieredNames[Id];
+        Function *F = M.getFunction(Name);
+        if (!F) return false;
+
+        // Callers keep referring to Name, which becomes the stub; the
+        // tier-0 body moves to Name.tier0.
+        F->setName(Name + ".tier0");
+        Function *Decl = Function::Create(F->getFunctionType(), Function::ExternalLinkage, Name, &M);
+        F->replaceAllUsesWith(Decl);
+
+        auto *Counter = new GlobalVariable(M, Int64Ty, false, GlobalValue::PrivateLinkage,
+                                           ConstantInt::get(Int64Ty, 0), Name + ".calls");
+
+        BasicBlock &Entry = F->getEntryBlock();
+        BasicBlock::iterator SplitAt = Entry.begin();
+        while (isa<AllocaInst>(*SplitAt)) ++SplitAt;
+        BasicBlock *Body = Entry.splitBasicBlock(SplitAt, "tier_body");
+        BasicBlock *HotBB = BasicBlock::Create(Ctx, "tier_up", F, Body);
+        Entry.getTerminator()->eraseFromParent();
+
+        IRBuilder<> B(&Entry);
+        Value *Count = B.CreateLoad(Int64Ty, Counter, "calls");
+        Value *Next = B.CreateAdd(Count, ConstantInt::get(Int64Ty, 1), "calls_next");
+        B.CreateStore(Next, Counter);
+        Value *IsHot = B.CreateICmpEQ(Next, ConstantInt::get(Int64Ty, Threshold), "is_hot");
+        B.CreateCondBr(IsHot, HotBB, Body);
+
+        B.SetInsertPoint(HotBB);
+        B.CreateCall(TierUp, {SelfPtr, ConstantInt::get(Int64Ty, Id)});
+        B.CreateBr(Body);
+    }
+    return true;
+}
+
+bool TieredJIT::createStubs() {
+    LLJIT &J = BaseJIT.getLLJIT();
+    Stubs = createLocalIndirectStubsManagerBuilder(J.getTargetTriple())();
+    if (!Stubs) {
+        fprintf(stderr, "Error: Indirection stubs are not supported on this target\n");
+        return false;
+    }
+
+    JITSymbolFlags Flags = JITSymbolFlags::Exported | JITSymbolFlags::Callable;
+    SymbolMap Symbols;
+    Symbols[J.mangleAndIntern(TierUpName)] =
+        makeSymbol(reinterpret_cast<uintptr_t>(&tierUpTrampoline), Flags);
+
+    for (const auto &Name : TieredNames) {
+        if (reportIfError("Cannot create stub", Stubs->createStub(Name, toStubAddr(0), Flags)))
+            return false;
+        Symbols[J.mangleAndIntern(Name)] = makeSymbol(getStubAddress(Stubs->findStub(Name, true)), Flags);
+    }
+
+    return !reportIfError("Cannot define stubs",
+                          J.getMainJITDylib().define(absoluteSymbols(std::move(Symbols))));
+}
+
+bool TieredJIT::addModule(std::unique_ptr<Module> M, std::unique_ptr<LLVMContext> Ctx) {
+    if (!isValid() || !M || !Ctx) return false;
+    BaseJIT.configureModule(*M);
+
+    for (auto &F : *M) {
+        if (!F.isDeclaration() && F.getName() != "main") {
+            TieredNames.push_back(F.getName().str());
+        }
+    }
+
+    raw_svector_ostream BitcodeOS(PristineBitcode);
+    WriteBitcodeToFile(*M, BitcodeOS);
+
+    Promoted = std::make_unique<std::atomic<bool>[]>(TieredNames.size());
+    for (size_t i = 0; i < TieredNames.size(); ++i) Promoted[i] = false;
+
+    if (!instrumentTier0(*M) || !createStubs()) return false;
+    if (!BaseJIT.addModule(std::move(M), std::move(Ctx))) return false;
+
+    for (const auto &Name : TieredNames) {
+        uint64_t Addr = BaseJIT.lookupAddress(Name + ".tier0");
+        if (!Addr) return false;
+        if (reportIfError("Cannot update stub", Stubs->updatePointer(Name, toStubAddr(Addr))))
+            return false;
+    }
+
+    Worker = std::thread([this] { workerLoop(); });
+    return true;
+}
+
+int TieredJIT::runMain() {
+    return BaseJIT.runMain();
+}
+
+void TieredJIT::requestPromotion(uint64_t Id) {
+    if (Id >= TieredNames.size() || Promoted[Id].exchange(true)) return;
+    {
+        std::lock_guard<std::mutex> Lock(QueueMutex);
+        Queue.push_back(Id);
+    }
+    QueueCV.notify_one();
+}
+
+void TieredJIT::workerLoop() {
+    while (true) {
+        uint64_t Id;
+        {
+            std::unique_lock<std::mutex> Lock(QueueMutex);
+            QueueCV.wait(Lock, [this] { return Stopping || !Queue.empty(); });
+            if (Stopping) return;
+            Id = Queue.front();
+            Queue.pop_front();
+        }
+        if (promote(Id)) ++NumPromoted;
+    }
+}
+
+bool TieredJIT::promote(uint64_t Id) {
+    const std::string &Name = TieredNames[Id];
+
+    auto Ctx = std::make_unique<LLVMContext>();
+    auto Buffer = MemoryBufferRef(StringRef(PristineBitcode.data(), PristineBitcode.size()), "tier2");
+    auto ParsedOrErr = parseBitcodeFile(Buffer, *Ctx);
+    if (!ParsedOrErr) {
+        reportIfError("Cannot reload module for recompilation", ParsedOrErr.takeError());
+        return false;
+    }
+    std::unique_ptr<Module> M = std::move(*ParsedOrErr);
+
+    // Keep the other user functions as available_externally so the hot
+    // function can inline them; calls that stay out of line go through
+    // their stubs.
+    for (auto &F : *M) {
+        if (F.isDeclaration() || F.getName() == Name) continue;
+        if (F.getName() == "main") {
+            F.deleteBody();
+        } else {
+            F.setLinkage(GlobalValue::AvailableExternallyLinkage);
+        }
+    }
+
+    Function *Hot = M->getFunction(Name);
+    if (!Hot) return false;
+    Hot->setName(Name + ".tier2");
+
+    DiagnosticEngine Diags;
+    Optimizer Opt(HotOptLevel, Diags, HostTM.get());
+    if (!Opt.run(*M)) return false;
+    if (!BaseJIT.addModule(std::move(M), std::move(Ctx))) return false;
+
+    uint64_t Addr = BaseJIT.lookupAddress(Name + ".tier2");
+    if (!Addr) return false;
+    return !reportIfError("Cannot update stub", Stubs->updatePointer(Name, toStubAddr(Addr)));
+}
@@ -0,0 +1,141 @@
+#include "cps/Lexer.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+using namespace cps;
+
+// Below this a single thread lexes the buffer faster than a few can be
+// started and joined; above it each thread gets at least MinChunkSize.
+static constexpr size_t ParallelThreshold = 4u << 20;
+static constexpr size_t MinChunkSize = 1u << 20;
+
+namespace {
+
+// One line-aligned piece of the source, lexed with its own interner. Its
+// offsets and lines are relative to the chunk and its SymbolIDs are local.
+struct Chunk {
+    std::string_view Text;
+    Interner Names;
+    TokenStream Tokens;
+};
+
+// Where a chunk's tokens land in the merged stream.
+struct ChunkBase {
+    size_t Token = 0;
+    uint32_t Offset = 0;
+    uint32_t Line = 0;
+    uint32_t Integer = 0;
+    uint32_t Real = 0;
+    uint32_t String = 0;
+    std::vector<SymbolID> Symbols; // local SymbolID -> global
+};
+
+// Splits Src into about Count pieces, each ending just past a newline (or
+// at the end of the buffer), so that no token or comment spans two pieces.
+std::vector<std::string_view> splitAtLines(std::string_view Src, size_t Count) {
+    std::vector<std::string_view> Pieces;
+    size_t Begin = 0;
+    for (size_t i = 1; i < Count; ++i) {
+        size_t Target = std::max(Begin, Src.size() / Count * i);
+        const void *NL = memchr(Src.data() + Target, '\n', Src.size() - Target);
+        if (!NL) break;
+        size_t End = static_cast<size_t>(static_cast<const char *>(NL) - Src.data()) + 1;
+        Pieces.push_back(Src.substr(Begin, End - Begin));
+        Begin = End;
+    }
+    if (Begin < Src.size()) Pieces.push_back(Src.substr(Begin));
+    return Pieces;
+}
+
+template <typename Fn>
+void forEachChunk(size_t Count, Fn Body) {
+    std::vector<std::thread> Threads;
+    for (size_t i = 1; i < Count; ++i) Threads.emplace_back(Body, i);
+    Body(0);
+    for (auto &T : Threads) T.join();
+}
+
+} // namespace
+
+TokenStream cps::lexBuffer(std::string_view Src, Interner &Names, DiagnosticEngine &Diags) {
+    unsigned Cores = std::thread::hardware_concurrency();
+    size_t Count = std::min<size_t>(Cores ? Cores : 1, Src.size() / MinChunkSize);
+    if (Src.size() < ParallelThreshold || Count < 2) return Lexer(Src, Names, Diags).lexAll();
+
+    std::vector<std::string_view> Pieces = splitAtLines(Src, Count);
+    std::vector<Chunk> Chunks(Pieces.size());
+    for (size_t i = 0; i < Pieces.size(); ++i) Chunks[i].Text = Pieces[i];
+
+    forEachChunk(Chunks.size(), [&](size_t i) {
+        Chunk &C = Chunks[i];
+        C.Tokens = Lexer(C.Text, C.Names, Diags).lexAll();
+    });
+
+    // Every chunk but the last drops its tok_eof. A chunk whose tok_eof
+    // comes before its end hit a lexer error that stops the whole lex, so
+    // the chunks after it are discarded as a sequential lex would never
+    // have reached them (though any errors they reported are already
+    // printed). Identifiers are interned in chunk order, giving
+    // the same SymbolIDs as a sequential lex.
+    std::vector<ChunkBase> Bases;
+    ChunkBase Next;
+    for (Chunk &C : Chunks) {
+        const TokenStream &T = C.Tokens;
+        bool Stopped = T.Offsets.back() < C.Text.size();
+        bool Last = Stopped || &C == &Chunks.back();
+
+        ChunkBase Base = Next;
+        Base.Symbols.resize(C.Names.size());
+        for (SymbolID ID = 0; ID < C.Names.size(); ++ID) Base.Symbols[ID] = Names.intern(C.Names.get(ID));
+        Bases.push_back(std::move(Base));
+
+        Next.Token += T.size() - (Last ? 0 : 1);
+        Next.Offset += static_cast<uint32_t>(C.Text.size());
+        Next.Line += T.Lines.back() - 1;
+        Next.Integer += static_cast<uint32_t>(T.Integers.size());
+        Next.Real += static_cast<uint32_t>(T.Reals.size());
+        Next.String += static_cast<uint32_t>(T.Strings.size());
+        if (Last) break;
+    }
+
+    TokenStream Out;
+    Out.Kinds.resize(Next.Token);
+    Out.Offsets.resize(Next.Token);
+    Out.Lines.resize(Next.Token);
+    Out.Columns.resize(Next.Token);
+    Out.Payloads.resize(Next.Token);
+    Out.Integers.resize(Next.Integer);
+    Out.Reals.resize(Next.Real);
+    Out.Strings.resize(Next.String);
+
+    forEachChunk(Bases.size(), [&](size_t i) {
+        const TokenStream &T = Chunks[i].Tokens;
+        const ChunkBase &Base = Bases[i];
+        size_t N = (i + 1 < Bases.size() ? Bases[i + 1].Token : Next.Token) - Base.Token;
+
+        std::copy_n(T.Kinds.begin(), N, Out.Kinds.begin() + Base.Token);
+        std::copy_n(T.Columns.begin(), N, Out.Columns.begin() + Base.Token);
+        for (size_t j = 0; j < N; ++j) {
+            size_t K = Base.Token + j;
+            Out.Offsets[K] = T.Offsets[j] + Base.Offset;
+            Out.Lines[K] = T.Lines[j] + Base.Line;
+
+            uint32_t Payload = T.Payloads[j];
+            switch (T.Kinds[j]) {
+            case tok_identifier: Payload = Base.Symbols[Payload]; break;
+            case tok_number_int: Payload += Base.Integer; break;
+            case tok_number_real: Payload += Base.Real; break;
+            case tok_string_literal: Payload += Base.String; break;
+            default: break;
+            }
+            Out.Payloads[K] = Payload;
+        }
+
+        std::copy(T.Integers.begin(), T.Integers.end(), Out.Integers.begin() + Base.Integer);
+        std::copy(T.Reals.begin(), T.Reals.end(), Out.Reals.begin() + Base.Real);
+        std::copy(T.Strings.begin(), T.Strings.end(), Out.Strings.begin() + Base.String);
+    });
+
+    return Out;
+}
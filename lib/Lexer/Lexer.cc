@@ -1,211 +1,283 @@
 #include "cps/Lexer.h"
-#include <algorithm>
+#include "cps/Scan.h"
+#include <array>
 #include <cctype>
-#include <cstdio>
-#include <cstdlib>
-#include <string>
+#include <charconv>
+#include <cstdint>
+#include <system_error>
 
 using namespace cps;
 
-int Lexer::gettok() {
-    static int LastChar = ' ';
+namespace {
+
+struct Keyword {
+    std::string_view Spelling;
+    Token Tok;
+};
+
+constexpr Keyword Keywords[] = {
+    {"DECLARE", tok_declare},
+    {"INTEGER", tok_integer_kw},
+    {"BOOLEAN", tok_boolean_kw},
+    {"REAL", tok_real_kw},
+    {"STRING", tok_string_kw},
+    {"CHAR", tok_char_kw},
+    {"TRUE", tok_true},
+    {"FALSE", tok_false},
+    {"INPUT", tok_input},
+    {"OUTPUT", tok_output},
+    {"IF", tok_if},
+    {"THEN", tok_then},
+    {"ELSE", tok_else},
+    {"ENDIF", tok_endif},
+    {"WHILE", tok_while},
+    {"DO", tok_do},
+    {"ENDWHILE", tok_endwhile},
+    {"REPEAT", tok_repeat},
+    {"UNTIL", tok_until},
+    {"FOR", tok_for},
+    {"TO", tok_to},
+    {"STEP", tok_step},
+    {"NEXT", tok_next},
+    {"ARRAY", tok_array},
+    {"OF", tok_of},
+    {"DIV", tok_div},
+    {"MOD", tok_mod},
+    {"AND", tok_and},
+    {"OR", tok_or},
+    {"NOT", tok_not},
+    {"LENGTH", tok_length},
+    {"MID", tok_mid},
+    {"RIGHT", tok_right},
+    {"LEFT", tok_left},
+    {"LCASE", tok_lcase},
+    {"UCASE", tok_ucase},
+    {"FUNCTION", tok_function},
+    {"ENDFUNCTION", tok_endfunction},
+    {"PROCEDURE", tok_procedure},
+    {"ENDPROCEDURE", tok_endprocedure},
+    {"RETURN", tok_return},
+    {"RETURNS", tok_returns},
+    {"CALL", tok_call},
+    {"BYREF", tok_byref},
+    {"BYVAL", tok_byval},
+};
+
+constexpr size_t MinKeywordLength = 2;
+constexpr size_t MaxKeywordLength = 12;
+constexpr size_t KeywordTableSize = 128;
+
+// Perfect hash over the keyword set: length plus the first, second and last
+// characters (MOD and MID differ only in the second). The multipliers were
+// found by a brute-force search; the static_assert below rejects any
+// keyword added later that collides, in which case search for new ones.
+constexpr size_t hashKeyword(std::string_view S) {
+    return (S.size() +
+            static_cast<unsigned char>(S[0]) * 3 +
+            static_cast<unsigned char>(S[1]) * 8 +
+            static_cast<unsigned char>(S[S.size() - 1]) * 17) &
+           (KeywordTableSize - 1);
+}
 
-    while (isspace(LastChar)) {
-        if (LastChar == '\n') CurrentLine++;
-        LastChar = getchar();
+constexpr bool keywordHashIsPerfect() {
+    bool Used[KeywordTableSize] = {};
+    for (const Keyword &K : Keywords) {
+        if (K.Spelling.size() < MinKeywordLength || K.Spelling.size() > MaxKeywordLength) return false;
+        size_t Slot = hashKeyword(K.Spelling);
+        if (Used[Slot]) return false;
+        Used[Slot] = true;
     }
+    return true;
+}
 
-    if (LastChar == '"') {
-        StringVal.clear();
-        LastChar = getchar();
+static_assert(keywordHashIsPerfect(), "keyword hash has a collision; pick new multipliers");
 
-        while (LastChar != '"' && LastChar != EOF && LastChar != '\n') {
-            StringVal += static_cast<char>(LastChar);
-            LastChar = getchar();
-        }
+// Maps each hash slot to its index in Keywords, or -1 when empty.
+constexpr std::array<int8_t, KeywordTableSize> buildKeywordSlots() {
+    std::array<int8_t, KeywordTableSize> Slots{};
+    for (size_t i = 0; i < KeywordTableSize; ++i) Slots[i] = -1;
+    for (size_t i = 0; i < sizeof(Keywords) / sizeof(Keywords[0]); ++i) {
+        Slots[hashKeyword(Keywords[i].Spelling)] = static_cast<int8_t>(i);
+    }
+    return Slots;
+}
 
-        if (LastChar == '"') {
-            LastChar = getchar();
-        } else {
-            fprintf(stderr, "Error: Unterminated string literal\n");
+constexpr std::array<int8_t, KeywordTableSize> KeywordSlots = buildKeywordSlots();
+
+}
+
+// One hash and at most one string compare, instead of a chain of ~50.
+static int lookupKeyword(std::string_view S) {
+    if (S.size() < MinKeywordLength || S.size() > MaxKeywordLength) return tok_identifier;
+    int Slot = KeywordSlots[hashKeyword(S)];
+    if (Slot < 0 || Keywords[Slot].Spelling != S) return tok_identifier;
+    return Keywords[Slot].Tok;
+}
+
+static bool isIdentifierChar(char C) {
+    return isalnum(static_cast<unsigned char>(C)) || C == '_';
+}
+
+static bool isDigit(char C) {
+    return C >= '0' && C <= '9';
+}
+
+// Stops at the line break so that the caller counts it.
+void Lexer::skipLineComment() {
+    CurPtr = findEither(CurPtr, BufferEnd, '\n', '\r');
+}
+
+int Lexer::lexNumber() {
+    const char *Start = CurPtr;
+    bool isReal = false;
+    do {
+        ++CurPtr;
+        if (CurPtr != BufferEnd && *CurPtr == '.' && !isReal) {
+            isReal = true;
+            ++CurPtr;
         }
+    } while (CurPtr != BufferEnd && isDigit(*CurPtr));
 
-        return tok_string_literal;
+    if (isReal) {
+        std::from_chars(Start, CurPtr, RealVal);
+        return tok_number_real;
     }
 
-    if (LastChar == '\'') {
-        int CharCode = getchar();
-        if (CharCode == EOF || CharCode == '\n') {
-            fprintf(stderr, "Error: Unterminated char literal\n");
-            return tok_eof;
-        }
+    // Out-of-range literals saturate, as strtoll did.
+    auto Parsed = std::from_chars(Start, CurPtr, NumVal);
+    if (Parsed.ec == std::errc::result_out_of_range) NumVal = INT64_MAX;
+    return tok_number_int;
+}
 
-        int ClosingQuote = getchar();
-        if (ClosingQuote != '\'') {
-            fprintf(stderr, "Error: CHAR literal must contain exactly one character\n");
-            while (ClosingQuote != EOF && ClosingQuote != '\n' && ClosingQuote != '\'') {
-                ClosingQuote = getchar();
-            }
+int Lexer::gettok() {
+    for (;;) {
+        // Tokens are mostly separated by nothing or a single space; only
+        // longer runs such as indentation go to the block scanner.
+        if (CurPtr != BufferEnd && *CurPtr == ' ') ++CurPtr;
+        if (CurPtr != BufferEnd && isspace(static_cast<unsigned char>(*CurPtr))) {
+            CurPtr = skipWhitespace(CurPtr, BufferEnd, CurrentLine, LineStart);
         }
 
-        CharVal = static_cast<char>(CharCode);
-        StringVal.assign(1, CharVal);
-        LastChar = getchar();
-        return tok_char_literal;
+        TokStart = CurPtr;
+        if (CurPtr == BufferEnd) return tok_eof;
+        if (*CurPtr != '/' || CurPtr + 1 == BufferEnd || CurPtr[1] != '/') break;
+        skipLineComment();
     }
 
-    if (isalpha(LastChar)) {
-        IdentifierStr = static_cast<char>(LastChar);
-        while (isalnum((LastChar = getchar())) || LastChar == '_')
-            IdentifierStr += static_cast<char>(LastChar);
-
-        if (IdentifierStr == "DECLARE") return tok_declare;
-        if (IdentifierStr == "INTEGER") return tok_integer_kw;
-        if (IdentifierStr == "BOOLEAN") return tok_boolean_kw;
-        if (IdentifierStr == "REAL")    return tok_real_kw;
-        if (IdentifierStr == "STRING")  return tok_string_kw;
-        if (IdentifierStr == "CHAR")    return tok_char_kw;
-
-        if (IdentifierStr == "TRUE") return tok_true;
-        if (IdentifierStr == "FALSE") return tok_false;
-
-        if (IdentifierStr == "INPUT") return tok_input;
-        if (IdentifierStr == "OUTPUT") return tok_output;
-
-        if (IdentifierStr == "IF") return tok_if;
-        if (IdentifierStr == "THEN") return tok_then;
-        if (IdentifierStr == "ELSE") return tok_else;
-        if (IdentifierStr == "ENDIF") return tok_endif;
-
-        if (IdentifierStr == "WHILE") return tok_while;
-        if (IdentifierStr == "DO") return tok_do;
-        if (IdentifierStr == "ENDWHILE") return tok_endwhile;
-
-        if (IdentifierStr == "REPEAT") return tok_repeat;
-        if (IdentifierStr == "UNTIL") return tok_until;
-
-        if (IdentifierStr == "FOR") return tok_for;
-        if (IdentifierStr == "TO") return tok_to;
-        if (IdentifierStr == "STEP") return tok_step;
-        if (IdentifierStr == "NEXT") return tok_next;
-
-        if (IdentifierStr == "ARRAY") return tok_array;
-        if (IdentifierStr == "OF") return tok_of;
-
-        if (IdentifierStr == "DIV") return tok_div;
-        if (IdentifierStr == "MOD") return tok_mod;
-
-        if (IdentifierStr == "AND") return tok_and;
-        if (IdentifierStr == "OR") return tok_or;
-        if (IdentifierStr == "NOT") return tok_not;
-
-        if (IdentifierStr == "LENGTH") return tok_length;
-        if (IdentifierStr == "MID") return tok_mid;
-        if (IdentifierStr == "RIGHT") return tok_right;
-        if (IdentifierStr == "LEFT") return tok_left;
-        if (IdentifierStr == "LCASE") return tok_lcase;
-        if (IdentifierStr == "UCASE") return tok_ucase;
-
-        if (IdentifierStr == "FUNCTION") return tok_function;
-        if (IdentifierStr == "ENDFUNCTION") return tok_endfunction;
-        if (IdentifierStr == "PROCEDURE") return tok_procedure;
-        if (IdentifierStr == "ENDPROCEDURE") return tok_endprocedure;
-        if (IdentifierStr == "RETURN") return tok_return;
-        if (IdentifierStr == "RETURNS") return tok_returns;
-        if (IdentifierStr == "CALL") return tok_call;
-
-        if (IdentifierStr == "BYREF") return tok_byref;
-        if (IdentifierStr == "BYVAL") return tok_byval;
-
-        return tok_identifier;
-    }
+    char C = *CurPtr;
+
+    if (C == '"') {
+        const char *Start = ++CurPtr;
+        CurPtr = findEither(CurPtr, BufferEnd, '"', '\n');
+        StringVal = std::string_view(Start, static_cast<size_t>(CurPtr - Start));
 
-    if (isdigit(LastChar)) {
-        std::string NumStr;
-        bool isReal = false;
-        do {
-            NumStr += static_cast<char>(LastChar);
-            LastChar = getchar();
-            if (LastChar == '.' && !isReal) {
-                isReal = true;
-                NumStr += '.';
-                LastChar = getchar();
-            }
-        } while (isdigit(LastChar));
-
-        if (isReal) {
-            RealVal = strtod(NumStr.c_str(), nullptr);
-            return tok_number_real;
+        if (CurPtr != BufferEnd && *CurPtr == '"') {
+            ++CurPtr;
+        } else {
+            Diags.error("Unterminated string literal");
         }
 
-        NumVal = strtoll(NumStr.c_str(), nullptr, 10);
-        return tok_number_int;
+        return tok_string_literal;
     }
 
-    if (LastChar == '<') {
-        LastChar = getchar();
-        if (LastChar == '-') {
-            LastChar = getchar();
-            return tok_assign;
-        }
-        if (LastChar == '=') {
-            LastChar = getchar();
-            return tok_le;
+    if (C == '\'') {
+        ++CurPtr;
+        if (CurPtr == BufferEnd || *CurPtr == '\n') {
+            Diags.error("Unterminated char literal");
+            CurPtr = BufferEnd;
+            return tok_eof;
         }
-        if (LastChar == '>') {
-            LastChar = getchar();
-            return tok_ne;
+
+        const char *CharPos = CurPtr++;
+        if (CurPtr == BufferEnd || *CurPtr != '\'') {
+            Diags.error("CHAR literal must contain exactly one character");
+            while (CurPtr != BufferEnd && *CurPtr != '\n' && *CurPtr != '\'') ++CurPtr;
         }
-        return '<';
+        if (CurPtr != BufferEnd && *CurPtr == '\'') ++CurPtr;
+
+        CharVal = *CharPos;
+        StringVal = std::string_view(CharPos, 1);
+        return tok_char_literal;
     }
 
-    if (LastChar == '>') {
-        LastChar = getchar();
-        if (LastChar == '=') {
-            LastChar = getchar();
-            return tok_ge;
+    if (isalpha(static_cast<unsigned char>(C))) {
+        const char *Start = CurPtr++;
+        while (CurPtr != BufferEnd && isIdentifierChar(*CurPtr)) ++CurPtr;
+        IdentifierStr = std::string_view(Start, static_cast<size_t>(CurPtr - Start));
+
+        int Tok = lookupKeyword(IdentifierStr);
+        if (Tok == tok_identifier) {
+            IdentifierID = Names.intern(llvm::StringRef(IdentifierStr.data(), IdentifierStr.size()));
         }
-        return '>';
+        return Tok;
     }
 
-    if (LastChar == '=') {
-        LastChar = getchar();
-        return tok_eq;
-    }
+    if (isDigit(C)) return lexNumber();
 
-    if (LastChar == ':') {
-        LastChar = getchar();
+    ++CurPtr;
+    char Next = CurPtr != BufferEnd ? *CurPtr : '\0';
+
+    switch (C) {
+    case '<':
+        if (Next == '-') { ++CurPtr; return tok_assign; }
+        if (Next == '=') { ++CurPtr; return tok_le; }
+        if (Next == '>') { ++CurPtr; return tok_ne; }
+        return '<';
+    case '>':
+        if (Next == '=') { ++CurPtr; return tok_ge; }
+        return '>';
+    case '=':
+        return tok_eq;
+    case ':':
         return tok_colon;
+    default:
+        return static_cast<unsigned char>(C);
     }
+}
 
-    if (LastChar == '(') { LastChar = getchar(); return '('; }
-    if (LastChar == ')') { LastChar = getchar(); return ')'; }
-    if (LastChar == '[') { LastChar = getchar(); return '['; }
-    if (LastChar == ']') { LastChar = getchar(); return ']'; }
-    if (LastChar == ',') { LastChar = getchar(); return ','; }
-    if (LastChar == '+') { LastChar = getchar(); return '+'; }
-    if (LastChar == '-') { LastChar = getchar(); return '-'; }
-    if (LastChar == '*') { LastChar = getchar(); return '*'; }
-
-    if (LastChar == '/') {
-        int NextChar = getchar();
-        if (NextChar == '/') {
-            do {
-                LastChar = getchar();
-            } while (LastChar != EOF && LastChar != '\n' && LastChar != '\r');
-
-            if (LastChar != EOF)
-                return gettok();
-        } else {
-            LastChar = NextChar;
-            return '/';
+TokenStream Lexer::lexAll() {
+    TokenStream Out;
+    // Generated programs average somewhere above ten bytes per token.
+    size_t Expected = static_cast<size_t>(BufferEnd - CurPtr) / 10 + 1;
+    Out.Kinds.reserve(Expected);
+    Out.Offsets.reserve(Expected);
+    Out.Lines.reserve(Expected);
+    Out.Columns.reserve(Expected);
+    Out.Payloads.reserve(Expected);
+
+    for (;;) {
+        int Tok = gettok();
+
+        uint32_t Payload = 0;
+        switch (Tok) {
+        case tok_identifier:
+            Payload = IdentifierID;
+            break;
+        case tok_number_int:
+            Payload = static_cast<uint32_t>(Out.Integers.size());
+            Out.Integers.push_back(NumVal);
+            break;
+        case tok_number_real:
+            Payload = static_cast<uint32_t>(Out.Reals.size());
+            Out.Reals.push_back(RealVal);
+            break;
+        case tok_string_literal:
+            Payload = static_cast<uint32_t>(Out.Strings.size());
+            Out.Strings.push_back(StringVal);
+            break;
+        case tok_char_literal:
+            Payload = static_cast<unsigned char>(CharVal);
+            break;
+        default:
+            break;
         }
-    }
 
-    if (LastChar == EOF)
-        return tok_eof;
+        Out.Kinds.push_back(static_cast<int16_t>(Tok));
+        Out.Offsets.push_back(getTokenOffset());
+        Out.Lines.push_back(static_cast<uint32_t>(CurrentLine));
+        Out.Columns.push_back(getColumn());
+        Out.Payloads.push_back(Payload);
 
-    int ThisChar = LastChar;
-    LastChar = getchar();
-    return ThisChar;
+        if (Tok == tok_eof) return Out;
+    }
 }
@@ -0,0 +1,156 @@
+#include "cps/Scan.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CPS_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace cps;
+
+static bool isSpaceByte(char C) {
+    return C == ' ' || (C >= '\t' && C <= '\r');
+}
+
+static const char *skipWhitespaceScalar(const char *P, const char *End, int &Lines, const char *&LineStart) {
+    while (P != End && isSpaceByte(*P)) {
+        if (*P == '\n') {
+            Lines++;
+            LineStart = P + 1;
+        }
+        ++P;
+    }
+    return P;
+}
+
+static const char *findEitherScalar(const char *P, const char *End, char A, char B) {
+    while (P != End && *P != A && *P != B) ++P;
+    return P;
+}
+
+#ifdef CPS_SCAN_X86
+
+// Each block yields a bitmask with one bit per byte. The first clear bit of
+// the whitespace mask is where the scan stops, and only the newlines below
+// it are counted; the highest of those starts the current line.
+
+static void countNewlines(const char *Block, unsigned Newlines, int &Lines, const char *&LineStart) {
+    if (!Newlines) return;
+    Lines += __builtin_popcount(Newlines);
+    LineStart = Block + (31 - __builtin_clz(Newlines)) + 1;
+}
+
+static unsigned spaceMaskSSE2(__m128i X) {
+    // '\t'..'\r' is a range of five; an unsigned min finds X - '\t' <= 4.
+    __m128i T = _mm_sub_epi8(X, _mm_set1_epi8('\t'));
+    __m128i Ctrl = _mm_cmpeq_epi8(_mm_min_epu8(T, _mm_set1_epi8(4)), T);
+    __m128i Blank = _mm_cmpeq_epi8(X, _mm_set1_epi8(' '));
+    return static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(Ctrl, Blank)));
+}
+
+static const char *skipWhitespaceSSE2(const char *P, const char *End, int &Lines, const char *&LineStart) {
+    const __m128i NL = _mm_set1_epi8('\n');
+    while (End - P >= 16) {
+        __m128i X = _mm_loadu_si128(reinterpret_cast<const __m128i *>(P));
+        unsigned Stop = ~spaceMaskSSE2(X) & 0xFFFFu;
+        unsigned Newlines = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(X, NL)));
+        if (Stop) {
+            unsigned N = static_cast<unsigned>(__builtin_ctz(Stop));
+            countNewlines(P, Newlines & ((1u << N) - 1), Lines, LineStart);
+            return P + N;
+        }
+        countNewlines(P, Newlines, Lines, LineStart);
+        P += 16;
+    }
+    return skipWhitespaceScalar(P, End, Lines, LineStart);
+}
+
+static const char *findEitherSSE2(const char *P, const char *End, char A, char B) {
+    const __m128i VA = _mm_set1_epi8(A);
+    const __m128i VB = _mm_set1_epi8(B);
+    while (End - P >= 16) {
+        __m128i X = _mm_loadu_si128(reinterpret_cast<const __m128i *>(P));
+        unsigned Hits = static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(X, VA), _mm_cmpeq_epi8(X, VB))));
+        if (Hits) return P + __builtin_ctz(Hits);
+        P += 16;
+    }
+    return findEitherScalar(P, End, A, B);
+}
+
+__attribute__((target("avx2,popcnt")))
+static unsigned spaceMaskAVX2(__m256i X) {
+    __m256i T = _mm256_sub_epi8(X, _mm256_set1_epi8('\t'));
+    __m256i Ctrl = _mm256_cmpeq_epi8(_mm256_min_epu8(T, _mm256_set1_epi8(4)), T);
+    __m256i Blank = _mm256_cmpeq_epi8(X, _mm256_set1_epi8(' '));
+    return static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(Ctrl, Blank)));
+}
+
+__attribute__((target("avx2,popcnt")))
+static const char *skipWhitespaceAVX2(const char *P, const char *End, int &Lines, const char *&LineStart) {
+    const __m256i NL = _mm256_set1_epi8('\n');
+    while (End - P >= 32) {
+        __m256i X = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(P));
+        unsigned Stop = ~spaceMaskAVX2(X);
+        unsigned Newlines = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(X, NL)));
+        if (Stop) {
+            unsigned N = static_cast<unsigned>(__builtin_ctz(Stop));
+            countNewlines(P, Newlines & ((1u << N) - 1), Lines, LineStart);
+            return P + N;
+        }
+        countNewlines(P, Newlines, Lines, LineStart);
+        P += 32;
+    }
+    return skipWhitespaceSSE2(P, End, Lines, LineStart);
+}
+
+__attribute__((target("avx2")))
+static const char *findEitherAVX2(const char *P, const char *End, char A, char B) {
+    const __m256i VA = _mm256_set1_epi8(A);
+    const __m256i VB = _mm256_set1_epi8(B);
+    while (End - P >= 32) {
+        __m256i X = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(P));
+        unsigned Hits = static_cast<unsigned>(
+            _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(X, VA), _mm256_cmpeq_epi8(X, VB))));
+        if (Hits) return P + __builtin_ctz(Hits);
+        P += 32;
+    }
+    return findEitherSSE2(P, End, A, B);
+}
+
+#endif // CPS_SCAN_X86
+
+namespace {
+
+struct ScanImpl {
+    const char *Name;
+    const char *(*SkipWhitespace)(const char *, const char *, int &, const char *&);
+    const char *(*FindEither)(const char *, const char *, char, char);
+};
+
+ScanImpl selectScanImpl() {
+#ifdef CPS_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {"avx2", skipWhitespaceAVX2, findEitherAVX2};
+    }
+    return {"sse2", skipWhitespaceSSE2, findEitherSSE2};
+#else
+    return {"scalar", skipWhitespaceScalar, findEitherScalar};
+#endif
+}
+
+const ScanImpl Impl = selectScanImpl();
+
+} // namespace
+
+const char *cps::skipWhitespace(const char *P, const char *End, int &Lines, const char *&LineStart) {
+    return Impl.SkipWhitespace(P, End, Lines, LineStart);
+}
+
+const char *cps::findEither(const char *P, const char *End, char A, char B) {
+    return Impl.FindEither(P, End, A, B);
+}
+
+const char *cps::getScanImplName() {
+    return Impl.Name;
+}
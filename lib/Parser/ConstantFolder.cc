@@ -0,0 +1,170 @@
+#include "cps/ConstantFolder.h"
+#include "cps/Lexer.h"
+#include <cstdint>
+#include <limits>
+#include <string>
+
+using namespace llvm;
+using namespace cps;
+
+// A string literal as the runtime sees it: up to its first NUL.
+static bool getString(ExprAST *E, StringRef &S) {
+    auto *Str = dyn_cast<StringExprAST>(E);
+    if (!Str) return false;
+    S = Str->getVal();
+    S = S.substr(0, S.find('\0'));
+    return true;
+}
+
+static bool getInteger(ExprAST *E, int64_t &V) {
+    auto *Int = dyn_cast<IntegerExprAST>(E);
+    if (!Int) return false;
+    V = Int->getVal();
+    return true;
+}
+
+// INTEGER and REAL literals, widened to double as codegen's sitofp does.
+static bool getNumber(ExprAST *E, double &V) {
+    if (auto *Int = dyn_cast<IntegerExprAST>(E)) {
+        V = static_cast<double>(Int->getVal());
+        return true;
+    }
+    if (auto *Real = dyn_cast<RealExprAST>(E)) {
+        V = Real->getVal();
+        return true;
+    }
+    return false;
+}
+
+// The truth value AND, OR and NOT give a literal: non-zero for INTEGER
+// and CHAR, ordered non-zero for REAL.
+static bool getTruth(ExprAST *E, bool &V) {
+    switch (E->getKind()) {
+        case ExprAST::EK_Boolean: V = cast<BooleanExprAST>(E)->getVal(); return true;
+        case ExprAST::EK_Integer: V = cast<IntegerExprAST>(E)->getVal() != 0; return true;
+        case ExprAST::EK_Char: V = cast<CharExprAST>(E)->getVal() != 0; return true;
+        case ExprAST::EK_Real: {
+            double D = cast<RealExprAST>(E)->getVal();
+            V = D < 0.0 || D > 0.0;
+            return true;
+        }
+        default: return false;
+    }
+}
+
+// Wrapping two's complement arithmetic, as LLVM's add/sub/mul.
+static int64_t wrap(uint64_t V) {
+    return static_cast<int64_t>(V);
+}
+
+ExprAST *ConstantFolder::foldUnary(int Op, ExprAST *Operand) {
+    bool V;
+    if (Op != tok_not || !getTruth(Operand, V)) return nullptr;
+    return Ctx.create<BooleanExprAST>(!V);
+}
+
+ExprAST *ConstantFolder::foldBinary(int Op, ExprAST *LHS, ExprAST *RHS) {
+    if (Op == '&') {
+        StringRef L, R;
+        if (!getString(LHS, L) || !getString(RHS, R)) return nullptr;
+        std::string Joined = L.str();
+        Joined += R;
+        return Ctx.create<StringExprAST>(Ctx.copyString(Joined));
+    }
+
+    if (Op == tok_and || Op == tok_or) {
+        bool L, R;
+        // Codegen only converts INTEGER and REAL operands to truth values.
+        if (isa<CharExprAST>(LHS) || isa<CharExprAST>(RHS)) return nullptr;
+        if (!getTruth(LHS, L) || !getTruth(RHS, R)) return nullptr;
+        return Ctx.create<BooleanExprAST>(Op == tok_and ? L && R : L || R);
+    }
+
+    auto *LBool = dyn_cast<BooleanExprAST>(LHS);
+    auto *RBool = dyn_cast<BooleanExprAST>(RHS);
+    if (LBool && RBool) {
+        if (Op == tok_eq) return Ctx.create<BooleanExprAST>(LBool->getVal() == RBool->getVal());
+        if (Op == tok_ne) return Ctx.create<BooleanExprAST>(LBool->getVal() != RBool->getVal());
+        return nullptr;
+    }
+
+    int64_t LInt, RInt;
+    if (getInteger(LHS, LInt) && getInteger(RHS, RInt)) {
+        uint64_t L = static_cast<uint64_t>(LInt), R = static_cast<uint64_t>(RInt);
+        switch (Op) {
+            case '+': return Ctx.create<IntegerExprAST>(wrap(L + R));
+            case '-': return Ctx.create<IntegerExprAST>(wrap(L - R));
+            case '*': return Ctx.create<IntegerExprAST>(wrap(L * R));
+            // The quotient of two INTEGERs is typed INTEGER even though codegen
+            // computes it as a REAL, so a REAL literal would change its output.
+            case '/': return nullptr;
+            case tok_div:
+            case tok_mod:
+                if (RInt == 0 || (LInt == std::numeric_limits<int64_t>::min() && RInt == -1)) return nullptr;
+                return Ctx.create<IntegerExprAST>(Op == tok_div ? LInt / RInt : LInt % RInt);
+            case tok_eq: return Ctx.create<BooleanExprAST>(LInt == RInt);
+            case tok_ne: return Ctx.create<BooleanExprAST>(LInt != RInt);
+            case '<': return Ctx.create<BooleanExprAST>(LInt < RInt);
+            case '>': return Ctx.create<BooleanExprAST>(LInt > RInt);
+            case tok_le: return Ctx.create<BooleanExprAST>(LInt <= RInt);
+            case tok_ge: return Ctx.create<BooleanExprAST>(LInt >= RInt);
+            default: return nullptr;
+        }
+    }
+
+    double L, R;
+    if (!getNumber(LHS, L) || !getNumber(RHS, R)) return nullptr;
+    // Ordered comparisons throughout: any comparison with a NaN is false.
+    switch (Op) {
+        case '+': return Ctx.create<RealExprAST>(L + R);
+        case '-': return Ctx.create<RealExprAST>(L - R);
+        case '*': return Ctx.create<RealExprAST>(L * R);
+        case '/': return Ctx.create<RealExprAST>(L / R);
+        case tok_eq: return Ctx.create<BooleanExprAST>(L == R);
+        case tok_ne: return Ctx.create<BooleanExprAST>(L < R || L > R);
+        case '<': return Ctx.create<BooleanExprAST>(L < R);
+        case '>': return Ctx.create<BooleanExprAST>(L > R);
+        case tok_le: return Ctx.create<BooleanExprAST>(L <= R);
+        case tok_ge: return Ctx.create<BooleanExprAST>(L >= R);
+        default: return nullptr;
+    }
+}
+
+ExprAST *ConstantFolder::foldCall(SymbolID Callee, ArrayRef<ExprAST *> Args) {
+    StringRef S;
+    if (Args.empty() || !getString(Args[0], S)) return nullptr;
+    int64_t Len = static_cast<int64_t>(S.size());
+
+    switch (Callee) {
+        case Builtin_LENGTH:
+            if (Args.size() != 1) return nullptr;
+            return Ctx.create<IntegerExprAST>(Len);
+        case Builtin_LCASE:
+        case Builtin_UCASE:
+            // toupper/tolower in the C locale only touch ASCII letters.
+            if (Args.size() != 1) return nullptr;
+            return Ctx.create<StringExprAST>(Ctx.copyString(Callee == Builtin_LCASE ? S.lower() : S.upper()));
+        case Builtin_MID: {
+            int64_t Start, Count;
+            if (Args.size() != 3 || !getInteger(Args[1], Start) || !getInteger(Args[2], Count)) return nullptr;
+            int64_t From = wrap(static_cast<uint64_t>(Start) - 1);
+            From = From < 0 ? 0 : (From > Len ? Len : From);
+            Count = Count > Len - From ? Len - From : Count;
+            if (Count < 0) Count = 0;
+            return Ctx.create<StringExprAST>(S.substr(From, Count));
+        }
+        case Builtin_LEFT: {
+            int64_t Count;
+            if (Args.size() != 2 || !getInteger(Args[1], Count)) return nullptr;
+            Count = Count < 0 ? 0 : (Count > Len ? Len : Count);
+            return Ctx.create<StringExprAST>(S.substr(0, Count));
+        }
+        case Builtin_RIGHT: {
+            int64_t Count;
+            if (Args.size() != 2 || !getInteger(Args[1], Count) || Count < 0) return nullptr;
+            return Ctx.create<StringExprAST>(S.substr(Count > Len ? 0 : Len - Count));
+        }
+        default:
+            return nullptr;
+    }
+}
@@ -1,11 +1,11 @@
 #include "cps/Parser.h"
 #include "cps/FunctionAST.h"
-#include <cstdio>
 
 using namespace cps;
 
-Parser::Parser(Lexer &L) : Lex(L) {
-    getNextToken();
+Parser::Parser(const TokenStream &Toks, Interner &Names, ASTContext &Ctx, DiagnosticEngine &Diags)
+    : Toks(Toks), Names(Names), Ctx(Ctx), Diags(Diags), Folder(Ctx) {
+    CurTok = Toks.Kinds[0];
 
     BinopPrecedence[tok_or] = 3;
     BinopPrecedence[tok_and] = 5;
@@ -36,68 +36,69 @@ int Parser::GetTokPrecedence() {
 }
 
 int Parser::getNextToken() {
-    return CurTok = Lex.gettok();
+    if (Pos + 1 < Toks.size()) ++Pos;
+    return CurTok = Toks.Kinds[Pos];
 }
 
-std::unique_ptr<ExprAST> Parser::ParseNumberExpr() {
+ExprAST *Parser::ParseNumberExpr() {
     if (CurTok == tok_number_real) {
-        auto Result = std::make_unique<RealExprAST>(Lex.RealVal);
+        auto Result = Ctx.create<RealExprAST>(Toks.Reals[Toks.Payloads[Pos]]);
         getNextToken();
         return Result;
     }
-    auto Result = std::make_unique<IntegerExprAST>(Lex.NumVal);
+    auto Result = Ctx.create<IntegerExprAST>(Toks.Integers[Toks.Payloads[Pos]]);
     getNextToken();
     return Result;
 }
 
-std::unique_ptr<ExprAST> Parser::ParseIdentifierExpr() {
-    std::string IdName = Lex.IdentifierStr;
-    int Line = Lex.getLine();
+ExprAST *Parser::ParseIdentifierExpr() {
+    SymbolID IdName = getIdentifier();
+    int Line = getLine();
     getNextToken();
 
     if (CurTok == '(') {
         getNextToken();
-        std::vector<std::unique_ptr<ExprAST>> Args;
+        llvm::SmallVector<ExprAST *, 4> Args;
         if (CurTok != ')') {
             while (true) {
                 if (auto Arg = ParseExpression())
-                    Args.push_back(std::move(Arg));
+                    Args.push_back(Arg);
                 else
                     return nullptr;
 
                 if (CurTok == ')') break;
 
                 if (CurTok != ',') {
-                    fprintf(stderr, "Error: Expected ')' or ',' in function call.\n");
+                    Diags.error("Expected ')' or ',' in function call.");
                     return nullptr;
                 }
                 getNextToken();
             }
         }
         getNextToken();
-        return std::make_unique<CallExprAST>(IdName, std::move(Args));
+        return Ctx.create<CallExprAST>(IdName, Ctx.copyList(Args));
     }
     
     if (CurTok == '[') {
         getNextToken();
-        std::vector<std::unique_ptr<ExprAST>> Indices;
+        llvm::SmallVector<ExprAST *, 4> Indices;
         while (true) {
             auto Exp = ParseExpression();
             if (!Exp) return nullptr;
-            Indices.push_back(std::move(Exp));
+            Indices.push_back(Exp);
             if (CurTok == ']') break;
             if (CurTok == ',') { getNextToken(); continue; }
-            fprintf(stderr, "Error: Expected ',' or ']'\n");
+            Diags.error("Expected ',' or ']'");
             return nullptr;
         }
         getNextToken(); 
-        return std::make_unique<ArrayAccessExprAST>(IdName, std::move(Indices), Line);
+        return Ctx.create<ArrayAccessExprAST>(IdName, Ctx.copyList(Indices), Line);
     }
     
-    return std::make_unique<VariableExprAST>(IdName);
+    return Ctx.create<VariableExprAST>(IdName);
 }
 
-std::string Parser::ParseTypeName(bool AllowVoid) {
+llvm::StringRef Parser::ParseTypeName(bool AllowVoid) {
     if (CurTok == tok_integer_kw) {
         getNextToken();
         return "INTEGER";
@@ -119,124 +120,128 @@ std::string Parser::ParseTypeName(bool AllowVoid) {
         return "CHAR";
     }
     if (CurTok == tok_identifier) {
-        std::string TypeName = Lex.IdentifierStr;
+        llvm::StringRef TypeName = Names.get(getIdentifier());
         if (!AllowVoid && TypeName == "VOID") {
-            fprintf(stderr, "Error: VOID is not allowed here\n");
+            Diags.error("VOID is not allowed here");
             return "";
         }
         getNextToken();
         return TypeName;
     }
 
-    fprintf(stderr, "Error: Unknown type name\n");
+    Diags.error("Unknown type name");
     return "";
 }
 
-std::unique_ptr<ExprAST> Parser::ParseStringBuiltin(const std::string &FuncName) {
+ExprAST *Parser::ParseStringBuiltin(SymbolID Callee) {
     getNextToken();
     if (CurTok != '(') {
-        fprintf(stderr, "Error: Expected '(' after %s\n", FuncName.c_str());
+        Diags.error("Expected '(' after %s", Names.get(Callee).data());
         return nullptr;
     }
     getNextToken();
 
-    std::vector<std::unique_ptr<ExprAST>> Args;
+    llvm::SmallVector<ExprAST *, 4> Args;
     if (CurTok != ')') {
         while (true) {
             if (auto Arg = ParseExpression())
-                Args.push_back(std::move(Arg));
+                Args.push_back(Arg);
             else
                 return nullptr;
 
             if (CurTok == ')') break;
             if (CurTok != ',') {
-                fprintf(stderr, "Error: Expected ',' or ')' in %s\n", FuncName.c_str());
+                Diags.error("Expected ',' or ')' in %s", Names.get(Callee).data());
                 return nullptr;
             }
             getNextToken();
         }
     }
     getNextToken(); 
-    return std::make_unique<CallExprAST>(FuncName, std::move(Args));
+    if (auto Folded = Folder.foldCall(Callee, Args)) return Folded;
+    return Ctx.create<CallExprAST>(Callee, Ctx.copyList(Args));
 }
 
-std::unique_ptr<ExprAST> Parser::ParseParenExpr() {
+ExprAST *Parser::ParseParenExpr() {
     getNextToken();
     auto V = ParseExpression();
     if (!V) return nullptr;
     if (CurTok != ')') {
-        fprintf(stderr, "Error: expected ')'\n");
+        Diags.error("expected ')'");
         return nullptr;
     }
     getNextToken();
     return V;
 }
 
-std::unique_ptr<ExprAST> Parser::ParsePrimary() {
+ExprAST *Parser::ParsePrimary() {
     switch (CurTok) {
     case tok_identifier: return ParseIdentifierExpr();
     case tok_number_int: return ParseNumberExpr();
     case tok_number_real: return ParseNumberExpr();
     case tok_string_literal: {
-        auto Res = std::make_unique<StringExprAST>(Lex.StringVal);
+        std::string_view Str = Toks.Strings[Toks.Payloads[Pos]];
+        auto Res = Ctx.create<StringExprAST>(llvm::StringRef(Str.data(), Str.size()));
         getNextToken();
         return Res;
     }
     case tok_char_literal: {
-        auto Res = std::make_unique<CharExprAST>(Lex.CharVal);
+        auto Res = Ctx.create<CharExprAST>(static_cast<char>(Toks.Payloads[Pos]));
         getNextToken();
         return Res;
     }
-    case tok_length: return ParseStringBuiltin("LENGTH");
-    case tok_mid:    return ParseStringBuiltin("MID");
-    case tok_right:  return ParseStringBuiltin("RIGHT");
-    case tok_left:   return ParseStringBuiltin("LEFT");
-    case tok_lcase:  return ParseStringBuiltin("LCASE");
-    case tok_ucase:  return ParseStringBuiltin("UCASE");
+    case tok_length: return ParseStringBuiltin(Builtin_LENGTH);
+    case tok_mid:    return ParseStringBuiltin(Builtin_MID);
+    case tok_right:  return ParseStringBuiltin(Builtin_RIGHT);
+    case tok_left:   return ParseStringBuiltin(Builtin_LEFT);
+    case tok_lcase:  return ParseStringBuiltin(Builtin_LCASE);
+    case tok_ucase:  return ParseStringBuiltin(Builtin_UCASE);
 
     case tok_true: {
         getNextToken();
-        return std::make_unique<BooleanExprAST>(true);
+        return Ctx.create<BooleanExprAST>(true);
     }
     case tok_false: {
         getNextToken();
-        return std::make_unique<BooleanExprAST>(false);
+        return Ctx.create<BooleanExprAST>(false);
     }
     case '(':            return ParseParenExpr();
     default:
-        fprintf(stderr, "Error: unknown token '%c' (%d) at line %d when expecting an expression\n", 
-                (char)CurTok, CurTok, Lex.getLine());
+        Diags.error("unknown token '%c' (%d) at line %d, column %d when expecting an expression", 
+                    (char)CurTok, CurTok, getLine(), getColumn());
         return nullptr;
     }
 }
 
-std::unique_ptr<ExprAST> Parser::ParseUnary() {
+ExprAST *Parser::ParseUnary() {
     if (CurTok == tok_not) {
         getNextToken();
         auto Operand = ParseUnary();
         if (!Operand) return nullptr;
-        return std::make_unique<UnaryExprAST>(tok_not, std::move(Operand));
+        if (auto Folded = Folder.foldUnary(tok_not, Operand)) return Folded;
+        return Ctx.create<UnaryExprAST>(tok_not, Operand);
     }
 
     if (CurTok == '-') {
-        int Line = Lex.getLine();
+        int Line = getLine();
         getNextToken();
         auto Operand = ParseUnary();
         if (!Operand) return nullptr;
-        auto Zero = std::make_unique<IntegerExprAST>(0);
-        return std::make_unique<BinaryExprAST>('-', std::move(Zero), std::move(Operand), Line);
+        auto Zero = Ctx.create<IntegerExprAST>(0);
+        if (auto Folded = Folder.foldBinary('-', Zero, Operand)) return Folded;
+        return Ctx.create<BinaryExprAST>('-', Zero, Operand, Line);
     }
 
     return ParsePrimary();
 }
 
-std::unique_ptr<ExprAST> Parser::ParseBinOpRHS(int ExprPrec, std::unique_ptr<ExprAST> LHS) {
+ExprAST *Parser::ParseBinOpRHS(int ExprPrec, ExprAST *LHS) {
     while (true) {
         int TokPrec = GetTokPrecedence();
         if (TokPrec < ExprPrec) return LHS;
 
         int BinOp = CurTok;
-        int Line = Lex.getLine();
+        int Line = getLine();
         getNextToken();
 
         auto RHS = ParseUnary();
@@ -244,36 +249,35 @@ std::unique_ptr<ExprAST> Parser::ParseBinOpRHS(int ExprPrec, std::unique_ptr<Exp
 
         int NextPrec = GetTokPrecedence();
         if (TokPrec < NextPrec) {
-            RHS = ParseBinOpRHS(TokPrec + 1, std::move(RHS));
+            RHS = ParseBinOpRHS(TokPrec + 1, RHS);
             if (!RHS) return nullptr;
         }
 
-        LHS = std::make_unique<BinaryExprAST>(BinOp, std::move(LHS), std::move(RHS), Line);
+        if (auto Folded = Folder.foldBinary(BinOp, LHS, RHS))
+            LHS = Folded;
+        else
+            LHS = Ctx.create<BinaryExprAST>(BinOp, LHS, RHS, Line);
     }
 }
 
-std::unique_ptr<ExprAST> Parser::ParseExpression() {
+ExprAST *Parser::ParseExpression() {
     auto LHS = ParseUnary();
     if (!LHS) return nullptr;
-    return ParseBinOpRHS(0, std::move(LHS));
+    return ParseBinOpRHS(0, LHS);
 }
 
-std::vector<std::unique_ptr<StmtAST>> Parser::Parse() {
-    std::vector<std::unique_ptr<StmtAST>> Statements;
+StmtAST *Parser::ParseNext() {
     while (CurTok != tok_eof) {
-        if (auto Stmt = ParseStatement()) {
-            Statements.push_back(std::move(Stmt));
-        } else {
-            if (CurTok != tok_eof) getNextToken();
-        }
+        if (auto Stmt = ParseStatement()) return Stmt;
+        if (CurTok != tok_eof) getNextToken();
     }
-    return Statements;
+    return nullptr;
 }
 
-std::unique_ptr<StmtAST> Parser::ParseDeclare() {
+StmtAST *Parser::ParseDeclare() {
     getNextToken(); 
     if (CurTok != tok_identifier) return nullptr;
-    std::string Name = Lex.IdentifierStr;
+    SymbolID Name = getIdentifier();
     getNextToken();
     
     if (CurTok != tok_colon) return nullptr;
@@ -282,19 +286,19 @@ std::unique_ptr<StmtAST> Parser::ParseDeclare() {
     if (CurTok == tok_array) {
         getNextToken(); 
         if (CurTok != '[') {
-            fprintf(stderr, "Error: Expected '[' after ARRAY\n");
+            Diags.error("Expected '[' after ARRAY");
             return nullptr;
         }
         getNextToken();
         
-        std::vector<std::pair<std::unique_ptr<ExprAST>, std::unique_ptr<ExprAST>>> Bounds;
+        llvm::SmallVector<std::pair<ExprAST *, ExprAST *>, 2> Bounds;
         
         while (true) {
             auto Lower = ParseExpression();
             if (!Lower) return nullptr;
             
             if (CurTok != tok_colon) {
-                fprintf(stderr, "Error: Expected ':' in array range (e.g. 1:10)\n");
+                Diags.error("Expected ':' in array range (e.g. 1:10)");
                 return nullptr;
             }
             getNextToken();
@@ -302,116 +306,116 @@ std::unique_ptr<StmtAST> Parser::ParseDeclare() {
             auto Upper = ParseExpression();
             if (!Upper) return nullptr;
             
-            Bounds.push_back({std::move(Lower), std::move(Upper)});
+            Bounds.push_back({Lower, Upper});
             
             if (CurTok == ']') break;
             if (CurTok == ',') {
                 getNextToken();
                 continue;
             }
-            fprintf(stderr, "Error: Expected ',' or ']' in array dims\n");
+            Diags.error("Expected ',' or ']' in array dims");
             return nullptr;
         }
         getNextToken();
         
         if (CurTok != tok_of) {
-            fprintf(stderr, "Error: Expected OF after array dims\n");
+            Diags.error("Expected OF after array dims");
             return nullptr;
         }
         getNextToken();
 
-        std::string TypeStr = ParseTypeName(false);
+        llvm::StringRef TypeStr = ParseTypeName(false);
         if (TypeStr.empty()) {
             return nullptr;
         }
         
-        return std::make_unique<ArrayDeclareStmtAST>(Name, std::move(Bounds), TypeStr);
+        return Ctx.create<ArrayDeclareStmtAST>(Name, Ctx.copyList(Bounds), TypeStr);
     } 
     else {
-        std::string TypeStr = ParseTypeName(false);
+        llvm::StringRef TypeStr = ParseTypeName(false);
         if (TypeStr.empty()) {
             return nullptr;
         }
-        return std::make_unique<DeclareStmtAST>(Name, TypeStr);
+        return Ctx.create<DeclareStmtAST>(Name, TypeStr);
     }
 }
 
-std::unique_ptr<StmtAST> Parser::ParseIfStmt() {
+StmtAST *Parser::ParseIfStmt() {
     getNextToken();
     auto Cond = ParseExpression();
     if (!Cond) return nullptr;
 
     if (CurTok != tok_then) {
-        fprintf(stderr, "Error: expected THEN\n");
+        Diags.error("expected THEN");
         return nullptr;
     }
     getNextToken();
 
-    std::vector<std::unique_ptr<StmtAST>> ThenStmts;
+    llvm::SmallVector<StmtAST *, 8> ThenStmts;
     while (CurTok != tok_else && CurTok != tok_endif && CurTok != tok_eof) {
         auto Stmt = ParseStatement();
-        if (Stmt) ThenStmts.push_back(std::move(Stmt));
+        if (Stmt) ThenStmts.push_back(Stmt);
         else if (CurTok != tok_eof && CurTok != tok_else && CurTok != tok_endif) getNextToken();
     }
 
-    std::vector<std::unique_ptr<StmtAST>> ElseStmts;
+    llvm::SmallVector<StmtAST *, 8> ElseStmts;
     if (CurTok == tok_else) {
         getNextToken();
         while (CurTok != tok_endif && CurTok != tok_eof) {
             auto Stmt = ParseStatement();
-            if (Stmt) ElseStmts.push_back(std::move(Stmt));
+            if (Stmt) ElseStmts.push_back(Stmt);
             else if (CurTok != tok_eof && CurTok != tok_endif) getNextToken();
         }
     }
 
     if (CurTok != tok_endif) {
-        fprintf(stderr, "Error: expected ENDIF\n");
+        Diags.error("expected ENDIF");
         return nullptr;
     }
     getNextToken();
 
-    return std::make_unique<IfStmtAST>(std::move(Cond), std::move(ThenStmts), std::move(ElseStmts));
+    return Ctx.create<IfStmtAST>(Cond, Ctx.copyList(ThenStmts), Ctx.copyList(ElseStmts));
 }
 
-std::unique_ptr<StmtAST> Parser::ParseWhileStmt() {
+StmtAST *Parser::ParseWhileStmt() {
     getNextToken();
     auto Cond = ParseExpression();
     if (!Cond) return nullptr;
 
     if (CurTok != tok_do) {
-        fprintf(stderr, "Error: expected DO after WHILE condition\n");
+        Diags.error("expected DO after WHILE condition");
         return nullptr;
     }
     getNextToken();
 
-    std::vector<std::unique_ptr<StmtAST>> Body;
+    llvm::SmallVector<StmtAST *, 8> Body;
     while (CurTok != tok_endwhile && CurTok != tok_eof) {
         auto Stmt = ParseStatement();
-        if (Stmt) Body.push_back(std::move(Stmt));
+        if (Stmt) Body.push_back(Stmt);
         else if (CurTok != tok_eof && CurTok != tok_endwhile) getNextToken();
     }
 
     if (CurTok != tok_endwhile) {
-        fprintf(stderr, "Error: expected ENDWHILE\n");
+        Diags.error("expected ENDWHILE");
         return nullptr;
     }
     getNextToken();
 
-    return std::make_unique<WhileStmtAST>(std::move(Cond), std::move(Body));
+    return Ctx.create<WhileStmtAST>(Cond, Ctx.copyList(Body));
 }
 
-std::unique_ptr<StmtAST> Parser::ParseRepeatStmt() {
+StmtAST *Parser::ParseRepeatStmt() {
     getNextToken();
 
-    std::vector<std::unique_ptr<StmtAST>> Body;
+    llvm::SmallVector<StmtAST *, 8> Body;
     while (CurTok != tok_until && CurTok != tok_eof) {
         auto Stmt = ParseStatement();
-        if (Stmt) Body.push_back(std::move(Stmt));
+        if (Stmt) Body.push_back(Stmt);
         else if (CurTok != tok_eof && CurTok != tok_until) getNextToken();
     }
 
     if (CurTok != tok_until) {
-        fprintf(stderr, "Error: expected UNTIL\n");
+        Diags.error("expected UNTIL");
         return nullptr;
     }
     getNextToken();
@@ -419,20 +423,20 @@ std::unique_ptr<StmtAST> Parser::ParseRepeatStmt() {
     auto Cond = ParseExpression();
     if (!Cond) return nullptr;
 
-    return std::make_unique<RepeatStmtAST>(std::move(Body), std::move(Cond));
+    return Ctx.create<RepeatStmtAST>(Ctx.copyList(Body), Cond);
 }
 
-std::unique_ptr<StmtAST> Parser::ParseForStmt() {
+StmtAST *Parser::ParseForStmt() {
     getNextToken();
     if (CurTok != tok_identifier) {
-        fprintf(stderr, "Error: expected identifier after FOR\n");
+        Diags.error("expected identifier after FOR");
         return nullptr;
     }
-    std::string VarName = Lex.IdentifierStr;
+    SymbolID VarName = getIdentifier();
     getNextToken();
 
     if (CurTok != tok_assign) {
-        fprintf(stderr, "Error: expected '<-' in FOR loop\n");
+        Diags.error("expected '<-' in FOR loop");
         return nullptr;
     }
     getNextToken();
@@ -441,7 +445,7 @@ std::unique_ptr<StmtAST> Parser::ParseForStmt() {
     if (!Start) return nullptr;
 
     if (CurTok != tok_to) {
-        fprintf(stderr, "Error: expected TO in FOR loop\n");
+        Diags.error("expected TO in FOR loop");
         return nullptr;
     }
     getNextToken();
@@ -449,90 +453,90 @@ std::unique_ptr<StmtAST> Parser::ParseForStmt() {
     auto End = ParseExpression();
     if (!End) return nullptr;
 
-    std::unique_ptr<ExprAST> Step = nullptr;
+    ExprAST *Step = nullptr;
     if (CurTok == tok_step) {
         getNextToken();
         Step = ParseExpression();
         if (!Step) return nullptr;
     }
 
-    std::vector<std::unique_ptr<StmtAST>> Body;
+    llvm::SmallVector<StmtAST *, 8> Body;
     while (CurTok != tok_next && CurTok != tok_eof) {
         auto Stmt = ParseStatement();
-        if (Stmt) Body.push_back(std::move(Stmt));
+        if (Stmt) Body.push_back(Stmt);
         else if (CurTok != tok_eof && CurTok != tok_next) getNextToken();
     }
 
     if (CurTok != tok_next) {
-        fprintf(stderr, "Error: expected NEXT\n");
+        Diags.error("expected NEXT");
         return nullptr;
     }
     getNextToken();
     
     if (CurTok != tok_identifier) {
-        fprintf(stderr, "Error: expected identifier after NEXT (e.g., NEXT %s)\n", VarName.c_str());
+        Diags.error("expected identifier after NEXT (e.g., NEXT %s)", Names.get(VarName).data());
         return nullptr;
     }
 
-    if (Lex.IdentifierStr != VarName) {
-        fprintf(stderr, "Error: NEXT identifier '%s' does not match FOR variable '%s'\n", 
-                Lex.IdentifierStr.c_str(), VarName.c_str());
+    if (getIdentifier() != VarName) {
+        Diags.error("NEXT identifier '%s' does not match FOR variable '%s'", 
+                    Names.get(getIdentifier()).data(), Names.get(VarName).data());
         return nullptr;
     }
     getNextToken();
 
-    return std::make_unique<ForStmtAST>(VarName, std::move(Start), std::move(End), std::move(Step), std::move(Body));
+    return Ctx.create<ForStmtAST>(VarName, Start, End, Step, Ctx.copyList(Body));
 }
 
-std::unique_ptr<StmtAST> Parser::ParseStatement() {
+StmtAST *Parser::ParseStatement() {
     if (CurTok == tok_declare) {
         return ParseDeclare();
     }
     else if (CurTok == tok_identifier) {
-        std::string Name = Lex.IdentifierStr;
-        int Line = Lex.getLine();
+        SymbolID Name = getIdentifier();
+        int Line = getLine();
         getNextToken();
         
         if (CurTok == '[') {
             getNextToken();
-            std::vector<std::unique_ptr<ExprAST>> Indices;
+            llvm::SmallVector<ExprAST *, 4> Indices;
             while (true) {
                 auto Exp = ParseExpression();
                 if (!Exp) return nullptr;
-                Indices.push_back(std::move(Exp));
+                Indices.push_back(Exp);
                 if (CurTok == ']') break;
                 if (CurTok == ',') getNextToken();
             }
             getNextToken();
             
             if (CurTok != tok_assign) {
-                fprintf(stderr, "Error: Expected '<-' after array access in assignment\n");
+                Diags.error("Expected '<-' after array access in assignment");
                 return nullptr;
             }
             getNextToken();
             auto Expr = ParseExpression();
             if (!Expr) return nullptr;
-            return std::make_unique<ArrayAssignStmtAST>(Name, std::move(Indices), std::move(Expr), Line);
+            return Ctx.create<ArrayAssignStmtAST>(Name, Ctx.copyList(Indices), Expr, Line);
         }
         
         if (CurTok != tok_assign) return nullptr;
         getNextToken();
         auto Expr = ParseExpression();
         if (!Expr) return nullptr;
-        return std::make_unique<AssignStmtAST>(Name, std::move(Expr));
+        return Ctx.create<AssignStmtAST>(Name, Expr);
     }
     else if (CurTok == tok_input) {
         getNextToken();
         if (CurTok != tok_identifier) return nullptr;
-        std::string Name = Lex.IdentifierStr;
+        SymbolID Name = getIdentifier();
         getNextToken();
-        return std::make_unique<InputStmtAST>(Name);
+        return Ctx.create<InputStmtAST>(Name);
     }
     else if (CurTok == tok_output) {
         getNextToken();
         auto Expr = ParseExpression();
         if (!Expr) return nullptr;
-        return std::make_unique<OutputStmtAST>(std::move(Expr));
+        return Ctx.create<OutputStmtAST>(Expr);
     }
     else if (CurTok == tok_if) {
         return ParseIfStmt();
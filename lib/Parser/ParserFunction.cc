@@ -1,12 +1,11 @@
 #include "cps/Parser.h"
 #include "cps/FunctionAST.h"
-#include <cstdio>
 #include <tuple>
 
 using namespace cps;
 
-std::vector<std::tuple<std::string, std::string, bool>> Parser::ParsePrototypeArgs() {
-    std::vector<std::tuple<std::string, std::string, bool>> Args;
+llvm::SmallVector<std::tuple<SymbolID, llvm::StringRef, bool>, 4> Parser::ParsePrototypeArgs() {
+    llvm::SmallVector<std::tuple<SymbolID, llvm::StringRef, bool>, 4> Args;
     if (CurTok != '(') return Args;
     getNextToken();
 
@@ -23,21 +22,21 @@ std::vector<std::tuple<std::string, std::string, bool>> Parser::ParsePrototypeAr
         }
 
         if (CurTok != tok_identifier) {
-            fprintf(stderr, "Error: Expected argument name\n");
+            Diags.error("Expected argument name");
             return Args;
         }
-        std::string Name = Lex.IdentifierStr;
+        SymbolID Name = getIdentifier();
         getNextToken();
 
         if (CurTok != tok_colon) {
-            fprintf(stderr, "Error: Expected ':' after argument name\n");
+            Diags.error("Expected ':' after argument name");
             return Args;
         }
         getNextToken();
 
-        std::string Type = ParseTypeName(false);
+        llvm::StringRef Type = ParseTypeName(false);
         if (Type.empty()) {
-            fprintf(stderr, "Error: Expected argument type for '%s'\n", Name.c_str());
+            Diags.error("Expected argument type for '%s'", Names.get(Name).data());
             return Args;
         }
 
@@ -45,7 +44,7 @@ std::vector<std::tuple<std::string, std::string, bool>> Parser::ParsePrototypeAr
 
         if (CurTok == ')') break;
         if (CurTok != ',') {
-            fprintf(stderr, "Error: Expected ',' or ')'\n");
+            Diags.error("Expected ',' or ')'");
             return Args;
         }
         getNextToken();
@@ -54,96 +53,96 @@ std::vector<std::tuple<std::string, std::string, bool>> Parser::ParsePrototypeAr
     return Args;
 }
 
-std::unique_ptr<StmtAST> Parser::ParseFunction() {
+StmtAST *Parser::ParseFunction() {
     getNextToken();
     if (CurTok != tok_identifier) {
-        fprintf(stderr, "Error: Expected function name\n");
+        Diags.error("Expected function name");
         return nullptr;
     }
 
-    std::string Name = Lex.IdentifierStr;
+    SymbolID Name = getIdentifier();
     getNextToken();
 
     auto Args = ParsePrototypeArgs();
 
-    std::string RetType = "INTEGER";
+    llvm::StringRef RetType = "INTEGER";
     if (CurTok == tok_returns) {
         getNextToken();
         RetType = ParseTypeName(true);
         if (RetType.empty()) {
-            fprintf(stderr, "Error: Expected return type for function '%s'\n", Name.c_str());
+            Diags.error("Expected return type for function '%s'", Names.get(Name).data());
             return nullptr;
         }
     }
 
-    auto Proto = std::make_unique<PrototypeAST>(Name, std::move(Args), RetType);
+    auto Proto = Ctx.create<PrototypeAST>(Name, Ctx.copyList(Args), RetType);
 
-    std::vector<std::unique_ptr<StmtAST>> Body;
+    llvm::SmallVector<StmtAST *, 8> Body;
     while (CurTok != tok_endfunction && CurTok != tok_eof) {
         auto Stmt = ParseStatement();
-        if (Stmt) Body.push_back(std::move(Stmt));
+        if (Stmt) Body.push_back(Stmt);
         else if (CurTok != tok_eof && CurTok != tok_endfunction) getNextToken();
     }
 
     if (CurTok != tok_endfunction) {
-        fprintf(stderr, "Error: expected ENDFUNCTION\n");
+        Diags.error("expected ENDFUNCTION");
         return nullptr;
     }
     getNextToken();
 
-    return std::make_unique<FunctionDefAST>(std::move(Proto), std::move(Body));
+    return Ctx.create<FunctionDefAST>(Proto, Ctx.copyList(Body));
 }
 
-std::unique_ptr<StmtAST> Parser::ParseProcedure() {
+StmtAST *Parser::ParseProcedure() {
     getNextToken();
     if (CurTok != tok_identifier) {
-        fprintf(stderr, "Error: Expected procedure name\n");
+        Diags.error("Expected procedure name");
         return nullptr;
     }
 
-    std::string Name = Lex.IdentifierStr;
+    SymbolID Name = getIdentifier();
     getNextToken();
 
     auto Args = ParsePrototypeArgs();
-    auto Proto = std::make_unique<PrototypeAST>(Name, std::move(Args), "VOID");
+    auto Proto = Ctx.create<PrototypeAST>(Name, Ctx.copyList(Args), "VOID");
 
-    std::vector<std::unique_ptr<StmtAST>> Body;
+    llvm::SmallVector<StmtAST *, 8> Body;
     while (CurTok != tok_endprocedure && CurTok != tok_eof) {
         auto Stmt = ParseStatement();
-        if (Stmt) Body.push_back(std::move(Stmt));
+        if (Stmt) Body.push_back(Stmt);
         else if (CurTok != tok_eof && CurTok != tok_endprocedure) getNextToken();
     }
 
     if (CurTok != tok_endprocedure) {
-        fprintf(stderr, "Error: expected ENDPROCEDURE\n");
+        Diags.error("expected ENDPROCEDURE");
         return nullptr;
     }
     getNextToken();
 
-    return std::make_unique<FunctionDefAST>(std::move(Proto), std::move(Body));
+    return Ctx.create<FunctionDefAST>(Proto, Ctx.copyList(Body));
 }
 
-std::unique_ptr<StmtAST> Parser::ParseCallStmt() {
+StmtAST *Parser::ParseCallStmt() {
     getNextToken();
     if (CurTok != tok_identifier) {
-        fprintf(stderr, "Error: Expected callee name after CALL\n");
+        Diags.error("Expected callee name after CALL");
         return nullptr;
     }
 
-    std::string Callee = Lex.IdentifierStr;
+    SymbolID Callee = getIdentifier();
     getNextToken();
 
-    std::vector<std::unique_ptr<ExprAST>> Args;
+    llvm::SmallVector<ExprAST *, 4> Args;
     if (CurTok == '(') {
         getNextToken();
         while (CurTok != ')') {
             auto Arg = ParseExpression();
-            if (Arg) Args.push_back(std::move(Arg));
+            if (Arg) Args.push_back(Arg);
             else return nullptr;
             
             if (CurTok == ')') break;
             if (CurTok != ',') {
-                fprintf(stderr, "Error: Expected ',' or ')' in call\n");
+                Diags.error("Expected ',' or ')' in call");
                 return nullptr;
             }
             getNextToken();
@@ -151,14 +150,14 @@ std::unique_ptr<StmtAST> Parser::ParseCallStmt() {
         getNextToken();
     }
     
-    return std::make_unique<CallStmtAST>(Callee, std::move(Args));
+    return Ctx.create<CallStmtAST>(Callee, Ctx.copyList(Args));
 }
 
-std::unique_ptr<StmtAST> Parser::ParseReturnStmt() {
+StmtAST *Parser::ParseReturnStmt() {
     getNextToken();
-    std::unique_ptr<ExprAST> Expr = nullptr;
+    ExprAST *Expr = nullptr;
     if (CurTok != tok_endif && CurTok != tok_else && CurTok != tok_endfunction && CurTok != tok_endprocedure) {
         Expr = ParseExpression();
     }
-    return std::make_unique<ReturnStmtAST>(std::move(Expr));
+    return Ctx.create<ReturnStmtAST>(Expr);
 }
@@ -0,0 +1,405 @@
+#include "cps/Sema.h"
+#include "cps/Lexer.h"
+
+using namespace llvm;
+using namespace cps;
+
+Sema::Sema(const Interner &Names, const TypeSystem &Types, DiagnosticEngine &Diags)
+    : Names(Names),
+      Types(Types),
+      Diags(Diags),
+      IntegerType(Types.resolve("INTEGER")),
+      RealType(Types.resolve("REAL")),
+      BooleanType(Types.resolve("BOOLEAN")),
+      CharType(Types.resolve("CHAR")),
+      StringType(Types.resolve("STRING")),
+      Symbols(Names) {}
+
+Sema::FunctionInfo &Sema::getFunction(SymbolID Name) {
+    if (Functions.size() <= Name) Functions.resize(Names.size());
+    return Functions[Name];
+}
+
+unsigned Sema::getArrayRank(SymbolID Name) const {
+    return Name < ArrayRanks.size() ? ArrayRanks[Name] : 0;
+}
+
+void Sema::check(StmtAST *Stmt) {
+    checkStmt(Stmt);
+}
+
+void Sema::checkBody(ArrayRef<StmtAST *> Body) {
+    for (StmtAST *Stmt : Body) checkStmt(Stmt);
+}
+
+bool Sema::checkIndices(ArrayRef<ExprAST *> Indices) {
+    for (ExprAST *Idx : Indices) {
+        if (!checkExpr(Idx)) return false;
+    }
+    return true;
+}
+
+bool Sema::checkExpr(ExprAST *Expr) {
+    if (!Expr) return false;
+
+    switch (Expr->getKind()) {
+        case ExprAST::EK_Integer:
+            Expr->setType(IntegerType);
+            return true;
+        case ExprAST::EK_Real:
+            Expr->setType(RealType);
+            return true;
+        case ExprAST::EK_Boolean:
+            Expr->setType(BooleanType);
+            return true;
+        case ExprAST::EK_Char:
+            Expr->setType(CharType);
+            return true;
+        case ExprAST::EK_String:
+            Expr->setType(StringType);
+            return true;
+        case ExprAST::EK_Variable: {
+            SymbolID Name = cast<VariableExprAST>(Expr)->getNameID();
+            const Symbol *Sym = Symbols.lookup(Name);
+            if (!Sym) {
+                Diags.error("Unknown variable name %s", Names.get(Name).data());
+                return false;
+            }
+            Expr->setType(Sym->Type);
+            if (Sym->IsArray) return true;
+            if (!Sym->Type || !Sym->Type->LLVMType) {
+                Diags.error("Unknown type for variable %s", Names.get(Name).data());
+                return false;
+            }
+            return true;
+        }
+        case ExprAST::EK_ArrayAccess: {
+            auto *Acc = cast<ArrayAccessExprAST>(Expr);
+            SymbolID Name = Acc->getNameID();
+            const Symbol *Sym = Symbols.lookup(Name);
+            Expr->setType(Sym ? Sym->Type : nullptr);
+            // An array declared inside a FUNCTION keeps its shape but not
+            // its storage once the function ends.
+            bool HasStorage = Sym != nullptr;
+
+            unsigned Rank = getArrayRank(Name);
+            if (!Rank) {
+                Diags.error("Undeclared array %s", Names.get(Name).data());
+                return false;
+            }
+            if (Acc->getIndices().size() != Rank) {
+                Diags.error("Incorrect number of indices for %s", Names.get(Name).data());
+                return false;
+            }
+            return checkIndices(Acc->getIndices()) && HasStorage;
+        }
+        case ExprAST::EK_Unary: {
+            auto *Unary = cast<UnaryExprAST>(Expr);
+            bool Ok = checkExpr(Unary->getOperand());
+            if (Unary->getOp() == tok_not) {
+                Expr->setType(BooleanType);
+                return Ok;
+            }
+            Expr->setType(Unary->getOperand()->getType());
+            return false;
+        }
+        case ExprAST::EK_Binary: {
+            auto *Bin = cast<BinaryExprAST>(Expr);
+            bool LOk = checkExpr(Bin->getLHS());
+            bool ROk = checkExpr(Bin->getRHS());
+
+            switch (Bin->getOp()) {
+                case tok_eq:
+                case tok_ne:
+                case '<':
+                case '>':
+                case tok_le:
+                case tok_ge:
+                case tok_and:
+                case tok_or:
+                    Expr->setType(BooleanType);
+                    break;
+                case '&':
+                    Expr->setType(StringType);
+                    break;
+                default: {
+                    const TypeInfo *L = Bin->getLHS()->getType();
+                    const TypeInfo *R = Bin->getRHS()->getType();
+                    bool IsReal = (L && L->isReal()) || (R && R->isReal());
+                    Expr->setType(IsReal ? RealType : IntegerType);
+                    break;
+                }
+            }
+            return LOk && ROk;
+        }
+        case ExprAST::EK_Call:
+            return checkCall(cast<CallExprAST>(Expr));
+    }
+
+    return false;
+}
+
+bool Sema::checkCall(CallExprAST *Call) {
+    ArrayRef<ExprAST *> Args = Call->getArgs();
+    const char *Builtin = nullptr;
+    size_t Arity = 1;
+    const TypeInfo *Result = nullptr;
+
+    switch (Call->getCalleeID()) {
+        case Builtin_LENGTH: Builtin = "LENGTH"; Result = IntegerType; break;
+        case Builtin_MID: Builtin = "MID"; Arity = 3; Result = StringType; break;
+        case Builtin_RIGHT: Builtin = "RIGHT"; Arity = 2; Result = StringType; break;
+        case Builtin_LEFT: Builtin = "LEFT"; Arity = 2; Result = StringType; break;
+        case Builtin_LCASE: Builtin = "LCASE"; Result = StringType; break;
+        case Builtin_UCASE: Builtin = "UCASE"; Result = StringType; break;
+        case Builtin_ASC: Result = IntegerType; break;
+        case Builtin_CHR: Result = StringType; break;
+        case Builtin_IS_NUM: Result = BooleanType; break;
+        case Builtin_NUM_TO_STR: Result = StringType; break;
+        case Builtin_STR_TO_NUM: Result = RealType; break;
+        default: {
+            bool Ok = checkCallArgs(Call->getCalleeID(), Args);
+            Call->setType(getFunction(Call->getCalleeID()).ReturnType);
+            return Ok;
+        }
+    }
+
+    Call->setType(Result);
+    if (Args.size() != Arity) {
+        // Only the string builtins have ever reported a bad arity.
+        if (Builtin) {
+            Diags.error("%s expects %zu arg%s", Builtin, Arity, Arity == 1 ? "" : "s");
+        }
+        return false;
+    }
+
+    bool Ok = true;
+    for (ExprAST *Arg : Args) Ok &= checkExpr(Arg);
+    return Ok;
+}
+
+bool Sema::checkCallArgs(SymbolID Callee, ArrayRef<ExprAST *> Args) {
+    // A routine called before its definition is declared from the first
+    // call, returning INTEGER and taking whatever that call passed.
+    bool Declared = getFunction(Callee).ReturnType != nullptr;
+
+    bool Ok = true;
+    for (size_t i = 0; i < Args.size(); ++i) {
+        const FunctionInfo &F = getFunction(Callee);
+        if (Declared && i < F.PointerParams.size() && F.PointerParams[i]) {
+            // Passed by address: codegen reports anything but a variable.
+            auto *Var = dyn_cast<VariableExprAST>(Args[i]);
+            if (!Var || !Symbols.lookup(Var->getNameID())) return false;
+            continue;
+        }
+        Ok &= checkExpr(Args[i]);
+    }
+    if (!Ok) return false;
+
+    FunctionInfo &F = getFunction(Callee);
+    if (!F.ReturnType) {
+        F.ReturnType = IntegerType;
+        for (ExprAST *Arg : Args) {
+            const TypeInfo *T = Arg->getType();
+            bool IsPointer = T && T->LLVMType && T->LLVMType->isPointerTy();
+            if (auto *Var = dyn_cast<VariableExprAST>(Arg)) {
+                const Symbol *Sym = Symbols.lookup(Var->getNameID());
+                IsPointer |= Sym && Sym->IsArray;
+            }
+            F.PointerParams.push_back(IsPointer);
+        }
+    }
+    return true;
+}
+
+void Sema::checkStmt(StmtAST *Stmt) {
+    if (!Stmt) return;
+
+    switch (Stmt->getKind()) {
+        case StmtAST::SK_Declare: {
+            auto *Decl = cast<DeclareStmtAST>(Stmt);
+            const TypeInfo *Type = Types.resolve(Decl->getType().str());
+            if (!Type || !Type->LLVMType || Type->isVoid()) {
+                Diags.error("Unknown type %s", Decl->getType().data());
+                return;
+            }
+            Symbols.declare(Decl->getNameID(), {Type, false});
+            return;
+        }
+        case StmtAST::SK_ArrayDeclare:
+            checkArrayDeclare(cast<ArrayDeclareStmtAST>(Stmt));
+            return;
+        case StmtAST::SK_Assign: {
+            auto *Assign = cast<AssignStmtAST>(Stmt);
+            StringRef Name = Names.get(Assign->getNameID());
+            const Symbol *Sym = Symbols.lookup(Assign->getNameID());
+            if (!Sym) {
+                Diags.error("Unknown variable name %s", Name.data());
+                return;
+            }
+            if (Sym->IsArray) {
+                Diags.error("Cannot assign array %s without indices", Name.data());
+                return;
+            }
+            checkExpr(Assign->getExpr());
+            return;
+        }
+        case StmtAST::SK_ArrayAssign:
+            checkArrayAssign(cast<ArrayAssignStmtAST>(Stmt));
+            return;
+        case StmtAST::SK_Input: {
+            auto *In = cast<InputStmtAST>(Stmt);
+            StringRef Name = Names.get(In->getNameID());
+            const Symbol *Sym = Symbols.lookup(In->getNameID());
+            if (!Sym) {
+                Diags.error("Unknown variable name %s", Name.data());
+                return;
+            }
+            if (Sym->IsArray) {
+                Diags.error("INPUT for entire array %s is not supported", Name.data());
+                return;
+            }
+            if (!Sym->Type) {
+                Diags.error("Unknown type for INPUT %s", Name.data());
+            }
+            return;
+        }
+        case StmtAST::SK_Output:
+            checkOutput(cast<OutputStmtAST>(Stmt));
+            return;
+        case StmtAST::SK_If: {
+            auto *If = cast<IfStmtAST>(Stmt);
+            if (!checkExpr(If->getCond())) return;
+            checkBody(If->getThenStmts());
+            checkBody(If->getElseStmts());
+            return;
+        }
+        case StmtAST::SK_While: {
+            auto *While = cast<WhileStmtAST>(Stmt);
+            if (!checkExpr(While->getCond())) return;
+            checkBody(While->getBody());
+            return;
+        }
+        case StmtAST::SK_Repeat: {
+            auto *Repeat = cast<RepeatStmtAST>(Stmt);
+            checkBody(Repeat->getBody());
+            checkExpr(Repeat->getCond());
+            return;
+        }
+        case StmtAST::SK_For:
+            checkFor(cast<ForStmtAST>(Stmt));
+            return;
+        case StmtAST::SK_FunctionDef:
+            checkFunctionDef(cast<FunctionDefAST>(Stmt));
+            return;
+        case StmtAST::SK_Call: {
+            auto *Call = cast<CallStmtAST>(Stmt);
+            checkCallArgs(Call->getCalleeID(), Call->getArgs());
+            return;
+        }
+        case StmtAST::SK_Return: {
+            auto *Ret = cast<ReturnStmtAST>(Stmt);
+            if (Ret->getRetVal()) checkExpr(Ret->getRetVal());
+            return;
+        }
+    }
+}
+
+void Sema::checkArrayDeclare(ArrayDeclareStmtAST *Stmt) {
+    const TypeInfo *ElemType = Types.resolve(Stmt->getType().str());
+    if (!ElemType || !ElemType->LLVMType || ElemType->isVoid()) {
+        Diags.error("Unknown array element type %s", Stmt->getType().data());
+        return;
+    }
+
+    for (const auto &Bound : Stmt->getBounds()) {
+        bool LOk = checkExpr(Bound.first);
+        bool ROk = checkExpr(Bound.second);
+        if (!LOk || !ROk) return;
+    }
+
+    SymbolID Name = Stmt->getNameID();
+    if (ArrayRanks.size() <= Name) ArrayRanks.resize(Names.size());
+    ArrayRanks[Name] = static_cast<unsigned>(Stmt->getBounds().size());
+    Symbols.declare(Name, {ElemType, true});
+}
+
+void Sema::checkArrayAssign(ArrayAssignStmtAST *Stmt) {
+    SymbolID Name = Stmt->getNameID();
+    unsigned Rank = getArrayRank(Name);
+    if (!Rank) {
+        Diags.error("Undeclared array %s", Names.get(Name).data());
+        return;
+    }
+    if (Stmt->getIndices().size() != Rank) {
+        Diags.error("Incorrect number of indices for %s", Names.get(Name).data());
+        return;
+    }
+    if (!checkIndices(Stmt->getIndices())) return;
+    checkExpr(Stmt->getExpr());
+}
+
+void Sema::checkOutput(OutputStmtAST *Stmt) {
+    ExprAST *Expr = Stmt->getExpr();
+
+    // A bare array name, or one given fewer indices than its rank, prints
+    // every element it covers.
+    if (auto *Var = dyn_cast<VariableExprAST>(Expr)) {
+        if (getArrayRank(Var->getNameID())) return;
+    } else if (auto *Acc = dyn_cast<ArrayAccessExprAST>(Expr)) {
+        unsigned Rank = getArrayRank(Acc->getNameID());
+        if (Rank && checkIndices(Acc->getIndices())) {
+            if (Acc->getIndices().size() > Rank) {
+                Diags.error("Incorrect number of indices for %s",
+                            Names.get(Acc->getNameID()).data());
+                return;
+            }
+            if (Acc->getIndices().size() < Rank) return;
+        }
+    }
+
+    checkExpr(Expr);
+}
+
+void Sema::checkFor(ForStmtAST *Stmt) {
+    StringRef Name = Names.get(Stmt->getVarNameID());
+    const Symbol *Sym = Symbols.lookup(Stmt->getVarNameID());
+    if (!Sym) {
+        Diags.error("Unknown variable in FOR loop %s", Name.data());
+        return;
+    }
+    if (Sym->Type != IntegerType) {
+        Diags.error("FOR loop variable %s must be INTEGER", Name.data());
+        return;
+    }
+
+    if (!checkExpr(Stmt->getStart())) return;
+    if (!checkExpr(Stmt->getEnd())) return;
+    checkBody(Stmt->getBody());
+    if (Stmt->getStep()) checkExpr(Stmt->getStep());
+}
+
+void Sema::checkFunctionDef(FunctionDefAST *Def) {
+    PrototypeAST *Proto = Def->getProto();
+    FunctionInfo &F = getFunction(Proto->getNameID());
+    if (F.Defined) return; // codegen reports the redefinition
+    F.Defined = true;
+
+    // A routine already declared by an earlier call keeps that signature.
+    if (!F.ReturnType) {
+        const TypeInfo *Ret = Types.resolve(Proto->getReturnType().str());
+        F.ReturnType = Ret ? Ret : IntegerType;
+        for (const auto &Arg : Proto->getArgs()) {
+            llvm::Type *T = Types.getLLVMType(std::get<1>(Arg).str());
+            F.PointerParams.push_back(std::get<2>(Arg) || (T && T->isPointerTy()));
+        }
+    }
+
+    Symbols.enterFunctionScope();
+    for (const auto &Arg : Proto->getArgs()) {
+        Symbols.declare(std::get<0>(Arg), {Types.resolve(std::get<1>(Arg).str()), false});
+    }
+
+    checkBody(Def->getBody());
+    Symbols.leaveScope();
+}
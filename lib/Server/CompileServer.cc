@@ -0,0 +1,485 @@
+#include "cps/CompileServer.h"
+#include "cps/Compiler.h"
+#include "cps/ObjectEmitter.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+#endif
+
+using namespace cps;
+
+// Wire format, all integers little-endian:
+//   request:  "CPS1" u8 mode, u8 opt-level, u32 len + source, u32 len + stdin
+//   response: "CPS1" u8 ok, i32 exit-code, u32 len + payload
+static const char ProtocolMagic[4] = {'C', 'P', 'S', '1'};
+
+static void appendU32(std::string &Out, uint32_t V) {
+    for (int i = 0; i < 4; ++i) Out.push_back(static_cast<char>((V >> (8 * i)) & 0xff));
+}
+
+static uint32_t readU32(const char *P) {
+    uint32_t V = 0;
+    for (int i = 0; i < 4; ++i) V |= static_cast<uint32_t>(static_cast<unsigned char>(P[i])) << (8 * i);
+    return V;
+}
+
+static std::string getErrorMessage(const char *What) {
+    return std::string("Error: ") + What + ": " + strerror(errno) + "\n";
+}
+
+static CompileResponse makeError(std::string Message) {
+    CompileResponse Resp;
+    Resp.Ok = false;
+    Resp.ExitCode = 1;
+    Resp.Payload = std::move(Message);
+    return Resp;
+}
+
+#ifndef _WIN32
+
+static bool writeAll(int FD, const char *Data, size_t Len) {
+    while (Len > 0) {
+        ssize_t N = write(FD, Data, Len);
+        if (N < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        Data += N;
+        Len -= static_cast<size_t>(N);
+    }
+    return true;
+}
+
+static bool readAll(int FD, char *Data, size_t Len) {
+    while (Len > 0) {
+        ssize_t N = read(FD, Data, Len);
+        if (N < 0 && errno == EINTR) continue;
+        if (N <= 0) return false;
+        Data += N;
+        Len -= static_cast<size_t>(N);
+    }
+    return true;
+}
+
+static bool readLength(int FD, uint32_t &Len) {
+    char Bytes[4];
+    if (!readAll(FD, Bytes, 4)) return false;
+    Len = readU32(Bytes);
+    return true;
+}
+
+static bool readBytes(int FD, std::string &Out, uint32_t Len) {
+    Out.resize(Len);
+    return Out.empty() || readAll(FD, &Out[0], Out.size());
+}
+
+static bool readString(int FD, std::string &Out) {
+    uint32_t Len;
+    return readLength(FD, Len) && readBytes(FD, Out, Len);
+}
+
+// Request fields are length-prefixed by the client; check the length
+// before allocating for it.
+static bool readRequestField(int FD, const char *What, std::string &Out, std::string &Rejection) {
+    uint32_t Len;
+    if (!readLength(FD, Len)) return false;
+    if (Len > MaxRequestFieldSize) {
+        Rejection = "Error: Request " + std::string(What) + " of " + std::to_string(Len) +
+                    " bytes exceeds the " + std::to_string(MaxRequestFieldSize >> 20) + " MiB limit\n";
+        return false;
+    }
+    return readBytes(FD, Out, Len);
+}
+
+static void writeResponse(int FD, const CompileResponse &Resp) {
+    std::string Out(ProtocolMagic, 4);
+    Out.push_back(Resp.Ok ? 1 : 0);
+    appendU32(Out, static_cast<uint32_t>(Resp.ExitCode));
+    appendU32(Out, static_cast<uint32_t>(Resp.Payload.size()));
+    Out += Resp.Payload;
+    writeAll(FD, Out.data(), Out.size());
+}
+
+static bool readMagic(int FD) {
+    char Magic[4];
+    return readAll(FD, Magic, 4) && memcmp(Magic, ProtocolMagic, 4) == 0;
+}
+
+static bool connectTo(const std::string &SocketPath, int &FD) {
+    sockaddr_un Addr;
+    memset(&Addr, 0, sizeof(Addr));
+    Addr.sun_family = AF_UNIX;
+    if (SocketPath.size() >= sizeof(Addr.sun_path)) {
+        fprintf(stderr, "Error: Socket path too long: %s\n", SocketPath.c_str());
+        return false;
+    }
+    memcpy(Addr.sun_path, SocketPath.c_str(), SocketPath.size() + 1);
+
+    FD = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (FD < 0 || connect(FD, reinterpret_cast<sockaddr *>(&Addr), sizeof(Addr)) < 0) {
+        fprintf(stderr, "%s", getErrorMessage(("Cannot connect to " + SocketPath).c_str()).c_str());
+        if (FD >= 0) close(FD);
+        return false;
+    }
+    return true;
+}
+
+static void setCloseOnExec(int FD) {
+    fcntl(FD, F_SETFD, fcntl(FD, F_GETFD) | FD_CLOEXEC);
+}
+
+// Held from pipe() until the spawn, so that no other worker's program can
+// be spawned while this worker's pipes are still inheritable.
+static std::mutex SpawnMutex;
+
+static bool makePipe(int FDs[2]) {
+    if (pipe(FDs) < 0) return false;
+    setCloseOnExec(FDs[0]);
+    setCloseOnExec(FDs[1]);
+    return true;
+}
+
+static int getMillisecondsLeft(std::chrono::steady_clock::time_point Deadline) {
+    auto Left = std::chrono::duration_cast<std::chrono::milliseconds>(Deadline - std::chrono::steady_clock::now());
+    return Left.count() > 0 ? static_cast<int>(Left.count()) : 0;
+}
+
+// Runs the compiled program as `RunnerPath --run-bitcode=BitcodePath` with
+// its stdin and stdout redirected to pipes, so concurrent requests never
+// share file descriptors and a crashing program cannot take the server down
+// with it. The program gets a freshly exec'd process: a child forked from
+// this multithreaded one could inherit a malloc, stdio or LLVM lock held
+// by another worker and deadlock. It is killed once it has run for
+// TimeoutSeconds.
+static CompileResponse runInChild(const std::string &RunnerPath, const std::string &BitcodePath,
+                                  const std::string &Input, unsigned TimeoutSeconds) {
+    int InPipe[2], OutPipe[2];
+    pid_t Pid;
+    int SpawnError;
+    {
+        std::lock_guard<std::mutex> Lock(SpawnMutex);
+        if (!makePipe(InPipe)) return makeError(getErrorMessage("pipe"));
+        if (!makePipe(OutPipe)) {
+            close(InPipe[0]);
+            close(InPipe[1]);
+            return makeError(getErrorMessage("pipe"));
+        }
+
+        posix_spawn_file_actions_t Actions;
+        posix_spawn_file_actions_init(&Actions);
+        posix_spawn_file_actions_adddup2(&Actions, InPipe[0], STDIN_FILENO);
+        posix_spawn_file_actions_adddup2(&Actions, OutPipe[1], STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&Actions, OutPipe[1], STDERR_FILENO);
+
+        // The server ignores SIGPIPE; the program should not.
+        posix_spawnattr_t Attr;
+        posix_spawnattr_init(&Attr);
+        sigset_t Defaults;
+        sigemptyset(&Defaults);
+        sigaddset(&Defaults, SIGPIPE);
+        posix_spawnattr_setsigdefault(&Attr, &Defaults);
+        posix_spawnattr_setflags(&Attr, POSIX_SPAWN_SETSIGDEF);
+
+        std::string BitcodeArg = "--run-bitcode=" + BitcodePath;
+        char *Argv[] = {const_cast<char *>(RunnerPath.c_str()), &BitcodeArg[0], nullptr};
+        SpawnError = posix_spawn(&Pid, RunnerPath.c_str(), &Actions, &Attr, Argv, environ);
+        posix_spawnattr_destroy(&Attr);
+        posix_spawn_file_actions_destroy(&Actions);
+    }
+
+    if (SpawnError) {
+        close(InPipe[0]);
+        close(InPipe[1]);
+        close(OutPipe[0]);
+        close(OutPipe[1]);
+        errno = SpawnError;
+        return makeError(getErrorMessage(("Cannot start " + RunnerPath).c_str()));
+    }
+
+    close(InPipe[0]);
+    close(OutPipe[1]);
+    auto Deadline = std::chrono::steady_clock::now() + std::chrono::seconds(TimeoutSeconds);
+    bool TimedOut = false;
+
+    // Feed stdin and drain stdout together so that neither pipe can fill up
+    // and deadlock against the child.
+    CompileResponse Resp;
+    size_t Written = 0;
+    int InFD = InPipe[1];
+    if (Input.empty()) {
+        close(InFD);
+        InFD = -1;
+    }
+    char Chunk[65536];
+    for (;;) {
+        pollfd FDs[2] = {{OutPipe[0], POLLIN, 0}, {InFD, POLLOUT, 0}};
+        int Ready = poll(FDs, InFD >= 0 ? 2 : 1, getMillisecondsLeft(Deadline));
+        if (Ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (Ready == 0) {
+            TimedOut = true;
+            kill(Pid, SIGKILL);
+            break;
+        }
+        if (InFD >= 0 && (FDs[1].revents & (POLLOUT | POLLERR | POLLHUP))) {
+            ssize_t N = write(InFD, Input.data() + Written, Input.size() - Written);
+            if (N > 0) Written += static_cast<size_t>(N);
+            if (N < 0 || Written == Input.size()) {
+                close(InFD);
+                InFD = -1;
+            }
+        }
+        if (FDs[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t N = read(OutPipe[0], Chunk, sizeof(Chunk));
+            if (N < 0 && errno == EINTR) continue;
+            if (N <= 0) break;
+            Resp.Payload.append(Chunk, static_cast<size_t>(N));
+        }
+    }
+    if (InFD >= 0) close(InFD);
+    close(OutPipe[0]);
+
+    // The child normally exits as its stdout closes; give it until the
+    // deadline to do so.
+    int Status = 0;
+    for (;;) {
+        pid_t Done = waitpid(Pid, &Status, TimedOut ? 0 : WNOHANG);
+        if (Done < 0 && errno == EINTR) continue;
+        if (Done != 0) break;
+        if (getMillisecondsLeft(Deadline) == 0) {
+            TimedOut = true;
+            kill(Pid, SIGKILL);
+            continue;
+        }
+        usleep(1000);
+    }
+    if (TimedOut) {
+        return makeError("Error: Program killed after running for " + std::to_string(TimeoutSeconds) + " s\n");
+    }
+    Resp.Ok = true;
+    Resp.ExitCode = WIFEXITED(Status) ? WEXITSTATUS(Status) : 128 + WTERMSIG(Status);
+    return Resp;
+}
+
+#endif
+
+CompileResponse cps::processRequest(const CompileRequest &Req, const std::string &RunnerPath,
+                                   unsigned RunTimeoutSeconds) {
+#ifdef _WIN32
+    return makeError("Error: The compile server is not supported on this platform\n");
+#else
+    // Every request gets its own lexer, parser and LLVMContext; nothing is
+    // shared between workers except the process-wide target registry.
+    CompileOptions Opts;
+    Opts.OptLevel = Req.OptLevel;
+    // Diagnostics go back to the client rather than to the server's stderr.
+    std::string Diagnostics;
+    Opts.OnError = [&Diagnostics](const std::string &Message) { Diagnostics += Message; };
+    auto CompileError = [&Diagnostics](const char *Fallback) {
+        return makeError(Diagnostics.empty() ? std::string(Fallback) : Diagnostics);
+    };
+
+    if (Req.Mode == RequestMode::Object) {
+        Opts.Output = CompileOutput::Object;
+        CompileResult Compiled = compile(Req.Source, Opts);
+        if (!Compiled.Ok) return CompileError("Error: Cannot compile program to an object\n");
+
+        CompileResponse Resp;
+        Resp.Ok = true;
+        Resp.Payload.assign(Compiled.Object.begin(), Compiled.Object.end());
+        return Resp;
+    }
+
+    CompileResult Compiled = compile(Req.Source, Opts);
+    if (!Compiled.Ok) return CompileError("Error: Generated module is invalid\n");
+
+    // The runner JITs the module from bitcode in its own process.
+    llvm::SmallString<128> BitcodePath;
+    int BitcodeFD;
+    if (llvm::sys::fs::createTemporaryFile("cps", "bc", BitcodeFD, BitcodePath)) {
+        return makeError("Error: Cannot create temporary bitcode file\n");
+    }
+    {
+        llvm::raw_fd_ostream OS(BitcodeFD, /*shouldClose=*/true);
+        llvm::WriteBitcodeToFile(*Compiled.Module, OS);
+        OS.close();
+        if (OS.has_error()) {
+            OS.clear_error();
+            llvm::sys::fs::remove(BitcodePath);
+            return makeError("Error: Cannot write temporary bitcode file\n");
+        }
+    }
+
+    CompileResponse Resp = runInChild(RunnerPath, BitcodePath.str().str(), Req.Input, RunTimeoutSeconds);
+    llvm::sys::fs::remove(BitcodePath);
+    return Resp;
+#endif
+}
+
+CompileServer::CompileServer(std::string SocketPath, unsigned NumWorkers, unsigned RunTimeoutSeconds)
+    : SocketPath(std::move(SocketPath)), NumWorkers(NumWorkers ? NumWorkers : 1),
+      RunTimeoutSeconds(RunTimeoutSeconds),
+      RunnerPath(llvm::sys::fs::getMainExecutable(nullptr, reinterpret_cast<void *>(&processRequest))) {}
+
+CompileServer::~CompileServer() {
+#ifndef _WIN32
+    if (ListenFD >= 0) {
+        close(ListenFD);
+        unlink(SocketPath.c_str());
+    }
+#endif
+    for (auto &Worker : Workers) Worker.detach();
+}
+
+void CompileServer::workerLoop() {
+    for (;;) {
+        int ClientFD;
+        {
+            std::unique_lock<std::mutex> Lock(QueueMutex);
+            QueueCV.wait(Lock, [this] { return !PendingClients.empty(); });
+            ClientFD = PendingClients.front();
+            PendingClients.pop_front();
+        }
+        handleClient(ClientFD);
+    }
+}
+
+void CompileServer::handleClient(int ClientFD) {
+#ifndef _WIN32
+    CompileRequest Req;
+    char Header[2];
+    std::string Rejection;
+    if (!readMagic(ClientFD) || !readAll(ClientFD, Header, 2) ||
+        !readRequestField(ClientFD, "source", Req.Source, Rejection) ||
+        !readRequestField(ClientFD, "input", Req.Input, Rejection)) {
+        if (Rejection.empty()) {
+            fprintf(stderr, "Error: Malformed compile request\n");
+        } else {
+            fprintf(stderr, "%s", Rejection.c_str());
+            writeResponse(ClientFD, makeError(Rejection));
+        }
+        close(ClientFD);
+        return;
+    }
+    Req.Mode = Header[0] == 1 ? RequestMode::Run : RequestMode::Object;
+    Req.OptLevel = static_cast<unsigned char>(Header[1]) > 3 ? 3 : static_cast<unsigned char>(Header[1]);
+
+    writeResponse(ClientFD, processRequest(Req, RunnerPath, RunTimeoutSeconds));
+    close(ClientFD);
+#endif
+}
+
+int CompileServer::run() {
+#ifdef _WIN32
+    fprintf(stderr, "Error: The compile server is not supported on this platform\n");
+    return 1;
+#else
+    // A client that disconnects early must not kill the server.
+    signal(SIGPIPE, SIG_IGN);
+
+    if (RunnerPath.empty()) {
+        fprintf(stderr, "Error: Cannot locate the cpsc executable to run programs with\n");
+        return 1;
+    }
+
+    sockaddr_un Addr;
+    memset(&Addr, 0, sizeof(Addr));
+    Addr.sun_family = AF_UNIX;
+    if (SocketPath.size() >= sizeof(Addr.sun_path)) {
+        fprintf(stderr, "Error: Socket path too long: %s\n", SocketPath.c_str());
+        return 1;
+    }
+    memcpy(Addr.sun_path, SocketPath.c_str(), SocketPath.size() + 1);
+
+    unlink(SocketPath.c_str());
+    ListenFD = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (ListenFD < 0 ||
+        bind(ListenFD, reinterpret_cast<sockaddr *>(&Addr), sizeof(Addr)) < 0 ||
+        listen(ListenFD, 64) < 0) {
+        fprintf(stderr, "%s", getErrorMessage(("Cannot listen on " + SocketPath).c_str()).c_str());
+        return 1;
+    }
+    setCloseOnExec(ListenFD);
+
+    ObjectEmitter::initializeNativeTarget();
+    for (unsigned i = 0; i < NumWorkers; ++i) {
+        Workers.emplace_back([this] { workerLoop(); });
+    }
+    fprintf(stderr, "cpsc: serving on %s with %u workers\n", SocketPath.c_str(), NumWorkers);
+
+    for (;;) {
+        int ClientFD = accept(ListenFD, nullptr, nullptr);
+        if (ClientFD < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            fprintf(stderr, "%s", getErrorMessage("accept").c_str());
+            return 1;
+        }
+        setCloseOnExec(ClientFD);
+        {
+            std::lock_guard<std::mutex> Lock(QueueMutex);
+            PendingClients.push_back(ClientFD);
+        }
+        QueueCV.notify_one();
+    }
+#endif
+}
+
+bool cps::sendCompileRequest(const std::string &SocketPath, const CompileRequest &Req, CompileResponse &Resp) {
+#ifdef _WIN32
+    fprintf(stderr, "Error: The compile server is not supported on this platform\n");
+    return false;
+#else
+    signal(SIGPIPE, SIG_IGN);
+
+    // The server would refuse these; say so without sending them.
+    for (const std::string *Field : {&Req.Source, &Req.Input}) {
+        if (Field->size() > MaxRequestFieldSize) {
+            fprintf(stderr, "Error: %s of %zu bytes exceeds the compile server's %u MiB limit\n",
+                    Field == &Req.Source ? "Program" : "Input", Field->size(), MaxRequestFieldSize >> 20);
+            return false;
+        }
+    }
+
+    int FD;
+    if (!connectTo(SocketPath, FD)) return false;
+
+    std::string Out(ProtocolMagic, 4);
+    Out.push_back(static_cast<char>(Req.Mode));
+    Out.push_back(static_cast<char>(Req.OptLevel));
+    appendU32(Out, static_cast<uint32_t>(Req.Source.size()));
+    Out += Req.Source;
+    appendU32(Out, static_cast<uint32_t>(Req.Input.size()));
+    Out += Req.Input;
+
+    char Header[5];
+    bool Ok = writeAll(FD, Out.data(), Out.size()) && readMagic(FD) &&
+              readAll(FD, Header, 5) && readString(FD, Resp.Payload);
+    close(FD);
+    if (!Ok) {
+        fprintf(stderr, "Error: Lost connection to compile server\n");
+        return false;
+    }
+    Resp.Ok = Header[0] != 0;
+    Resp.ExitCode = static_cast<int>(readU32(Header + 1));
+    return true;
+#endif
+}
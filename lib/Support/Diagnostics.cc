@@ -0,0 +1,31 @@
+#include "cps/Diagnostics.h"
+#include <cstdarg>
+#include <cstdio>
+
+using namespace cps;
+
+void DiagnosticEngine::error(const char *Fmt, ...) {
+    std::string Message = "Error: ";
+    va_list Args;
+    va_start(Args, Fmt);
+    va_list Copy;
+    va_copy(Copy, Args);
+    int Len = vsnprintf(nullptr, 0, Fmt, Copy);
+    va_end(Copy);
+    if (Len > 0) {
+        size_t Prefix = Message.size();
+        Message.resize(Prefix + static_cast<size_t>(Len) + 1);
+        vsnprintf(&Message[Prefix], static_cast<size_t>(Len) + 1, Fmt, Args);
+        Message.resize(Prefix + static_cast<size_t>(Len));
+    }
+    va_end(Args);
+    Message += '\n';
+
+    ++NumErrors;
+    std::lock_guard<std::mutex> Guard(Lock);
+    if (OnError) {
+        OnError(Message);
+    } else {
+        fputs(Message.c_str(), stderr);
+    }
+}
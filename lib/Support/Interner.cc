@@ -0,0 +1,17 @@
+#include "cps/Interner.h"
+
+using namespace cps;
+
+Interner::Interner() {
+    static const char *const BuiltinNames[NumBuiltins] = {
+        "LENGTH", "MID", "RIGHT", "LEFT", "LCASE", "UCASE",
+        "ASC", "CHR", "IS_NUM", "NUM_TO_STR", "STR_TO_NUM",
+    };
+    for (const char *Name : BuiltinNames) intern(Name);
+}
+
+SymbolID Interner::intern(llvm::StringRef Spelling) {
+    auto Inserted = IDs.try_emplace(Spelling, static_cast<SymbolID>(Spellings.size()));
+    if (Inserted.second) Spellings.push_back(Inserted.first->getKey());
+    return Inserted.first->getValue();
+}
@@ -0,0 +1,134 @@
+#include "cps/TimeReport.h"
+#include <chrono>
+#include <ctime>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace cps;
+
+static double getWallSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double getCPUSeconds() {
+#ifndef _WIN32
+    // Per-thread, so --batch workers and JIT threads do not bleed into it.
+    timespec TS;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &TS) == 0) {
+        return static_cast<double>(TS.tv_sec) + static_cast<double>(TS.tv_nsec) / 1e9;
+    }
+#endif
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+}
+
+static uint64_t getPeakRSSKB() {
+#ifndef _WIN32
+    rusage Usage;
+    if (getrusage(RUSAGE_SELF, &Usage) == 0) {
+#ifdef __APPLE__
+        return static_cast<uint64_t>(Usage.ru_maxrss) / 1024;
+#else
+        return static_cast<uint64_t>(Usage.ru_maxrss);
+#endif
+    }
+#endif
+    return 0;
+}
+
+TimeReport::Scope::Scope(TimeReport *Report, size_t Index) : Report(Report), Index(Index) {
+    if (!Report) return;
+    Parent = Report->Active;
+    Report->Active = this;
+    StartWall = getWallSeconds();
+    StartCPU = getCPUSeconds();
+}
+
+TimeReport::Scope::Scope(TimeReport *Report, const std::string &Name)
+    : Scope(Report, Report ? Report->getPhase(Name) : 0) {}
+
+TimeReport::Scope::~Scope() {
+    if (!Report) return;
+    double Wall = getWallSeconds() - StartWall;
+    double CPU = getCPUSeconds() - StartCPU;
+
+    Phase &P = Report->Phases[Index];
+    P.WallSeconds += Wall - ChildWall;
+    P.CPUSeconds += CPU - ChildCPU;
+    P.PeakRSSKB = getPeakRSSKB();
+    P.Count++;
+
+    if (Parent) {
+        Parent->ChildWall += Wall;
+        Parent->ChildCPU += CPU;
+    }
+    Report->Active = Parent;
+}
+
+size_t TimeReport::getPhase(const std::string &Name) {
+    auto It = PhaseIndex.find(Name);
+    if (It != PhaseIndex.end()) return It->second;
+
+    Phase P;
+    P.Name = Name;
+    Phases.push_back(P);
+    PhaseIndex[Name] = Phases.size() - 1;
+    return Phases.size() - 1;
+}
+
+void TimeReport::print(FILE *Out) const {
+    double TotalWall = 0;
+    double TotalCPU = 0;
+    for (const Phase &P : Phases) {
+        TotalWall += P.WallSeconds;
+        TotalCPU += P.CPUSeconds;
+    }
+
+    fprintf(Out, "===-------------------------------------------------------------===\n");
+    fprintf(Out, "                     cpsc time report\n");
+    fprintf(Out, "===-------------------------------------------------------------===\n");
+    fprintf(Out, "%12s %12s %7s %12s %10s  %s\n", "wall (ms)", "cpu (ms)", "wall %", "peak RSS KB", "count", "phase");
+    for (const Phase &P : Phases) {
+        fprintf(Out, "%12.3f %12.3f %6.1f%% %12llu %10llu  %s\n",
+                P.WallSeconds * 1000,
+                P.CPUSeconds * 1000,
+                TotalWall > 0 ? P.WallSeconds * 100 / TotalWall : 0.0,
+                static_cast<unsigned long long>(P.PeakRSSKB),
+                static_cast<unsigned long long>(P.Count),
+                P.Name.c_str());
+    }
+    fprintf(Out, "%12.3f %12.3f %6.1f%% %12llu %10s  %s\n",
+            TotalWall * 1000, TotalCPU * 1000, 100.0,
+            static_cast<unsigned long long>(getPeakRSSKB()), "", "total");
+}
+
+static void printJSONString(FILE *Out, const std::string &S) {
+    fputc('"', Out);
+    for (char C : S) {
+        if (C == '"' || C == '\\') {
+            fputc('\\', Out);
+            fputc(C, Out);
+        } else if (static_cast<unsigned char>(C) < 0x20) {
+            fprintf(Out, "\\u%04x", static_cast<unsigned char>(C));
+        } else {
+            fputc(C, Out);
+        }
+    }
+    fputc('"', Out);
+}
+
+void TimeReport::printJSON(FILE *Out) const {
+    fprintf(Out, "{\"phases\": [");
+    for (size_t i = 0; i < Phases.size(); ++i) {
+        const Phase &P = Phases[i];
+        fprintf(Out, "%s\n  {\"name\": ", i ? "," : "");
+        printJSONString(Out, P.Name);
+        fprintf(Out, ", \"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"peak_rss_kb\": %llu, \"count\": %llu}",
+                P.WallSeconds * 1000,
+                P.CPUSeconds * 1000,
+                static_cast<unsigned long long>(P.PeakRSSKB),
+                static_cast<unsigned long long>(P.Count));
+    }
+    fprintf(Out, "\n], \"peak_rss_kb\": %llu}\n", static_cast<unsigned long long>(getPeakRSSKB()));
+}
@@ -1,17 +1,449 @@
-#include "cps/Lexer.h"
-#include "cps/Parser.h"
-#include "cps/CodeGen.h"
+#include "cps/BatchCompiler.h"
+#include "cps/CompileCache.h"
+#include "cps/CompileServer.h"
+#include "cps/Compiler.h"
+#include "cps/JIT.h"
+#include "cps/ObjectEmitter.h"
+#include "cps/TieredJIT.h"
+#include "cps/TimeReport.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
-int main() {
-    cps::Lexer Lex;
+namespace {
 
-    cps::Parser Parser(Lex);
-    auto Statements = Parser.Parse();
+struct DriverOptions {
+    unsigned OptLevel = 0;
+    bool CompileOnly = false;
+    bool RunJIT = false;
+    bool Tiered = false;
+    bool Lazy = false;
+    uint64_t TierThreshold = 1000;
+    std::string OutputPath;
 
-    cps::CodeGen CG;
-    CG.compile(Statements);
+    std::string CacheDir;
+    uint64_t CacheSizeMB = 512;
+    bool CacheStats = false;
 
-    CG.print();
+    std::string ServerSocket;
+    std::string ClientSocket;
+    unsigned Workers = 0;
+    unsigned RunTimeout = 10; // seconds per --run request on the server
+    std::string RunBitcodePath; // set when spawned by the server to run a program
 
+    bool Batch = false;
+    std::vector<std::string> Inputs;
+
+    bool TimeReport = false;
+    bool TimeReportJSON = false;
+
+    unsigned CodeGenThreads = 1;
+};
+
+// Everything that runs after the main function exists in some form.
+struct Backends {
+    std::unique_ptr<cps::JIT> Runner;
+    std::unique_ptr<cps::TieredJIT> TieredRunner;
+};
+
+}
+
+static bool parseArgs(int argc, char **argv, DriverOptions &Opts) {
+    for (int i = 1; i < argc; ++i) {
+        const char *Arg = argv[i];
+        if (Arg[0] == '-' && Arg[1] == 'O' && Arg[2] >= '0' && Arg[2] <= '3' && Arg[3] == '\0') {
+            Opts.OptLevel = static_cast<unsigned>(Arg[2] - '0');
+        } else if (strcmp(Arg, "-O") == 0) {
+            Opts.OptLevel = 2;
+        } else if (strcmp(Arg, "-c") == 0) {
+            Opts.CompileOnly = true;
+        } else if (strcmp(Arg, "--run") == 0) {
+            Opts.RunJIT = true;
+        } else if (strcmp(Arg, "--lazy") == 0) {
+            Opts.RunJIT = true;
+            Opts.Lazy = true;
+        } else if (strcmp(Arg, "--tiered") == 0) {
+            Opts.RunJIT = true;
+            Opts.Tiered = true;
+        } else if (strncmp(Arg, "--tier-threshold=", 17) == 0) {
+            Opts.TierThreshold = strtoull(Arg + 17, nullptr, 10);
+            if (Opts.TierThreshold == 0) {
+                fprintf(stderr, "Error: --tier-threshold must be a positive integer\n");
+                return false;
+            }
+        } else if (strcmp(Arg, "--cache") == 0) {
+            Opts.CacheDir = cps::CompileCache::getDefaultDir();
+        } else if (strncmp(Arg, "--cache-dir=", 12) == 0) {
+            Opts.CacheDir = Arg + 12;
+        } else if (strncmp(Arg, "--cache-size=", 13) == 0) {
+            Opts.CacheSizeMB = strtoull(Arg + 13, nullptr, 10);
+        } else if (strcmp(Arg, "--cache-stats") == 0) {
+            Opts.CacheStats = true;
+        } else if (strncmp(Arg, "--server=", 9) == 0) {
+            Opts.ServerSocket = Arg + 9;
+        } else if (strncmp(Arg, "--workers=", 10) == 0) {
+            Opts.Workers = static_cast<unsigned>(strtoul(Arg + 10, nullptr, 10));
+        } else if (strncmp(Arg, "--run-timeout=", 14) == 0) {
+            Opts.RunTimeout = static_cast<unsigned>(strtoul(Arg + 14, nullptr, 10));
+            if (Opts.RunTimeout == 0) {
+                fprintf(stderr, "Error: --run-timeout must be a positive number of seconds\n");
+                return false;
+            }
+        } else if (strncmp(Arg, "--run-bitcode=", 14) == 0) {
+            Opts.RunBitcodePath = Arg + 14;
+        } else if (strncmp(Arg, "-j", 2) == 0) {
+            const char *Count = Arg[2] ? Arg + 2 : (i + 1 < argc ? argv[++i] : "");
+            Opts.CodeGenThreads = static_cast<unsigned>(strtoul(Count, nullptr, 10));
+            if (Opts.CodeGenThreads == 0) {
+                fprintf(stderr, "Error: -j requires a positive thread count\n");
+                return false;
+            }
+        } else if (strcmp(Arg, "-ftime-report") == 0) {
+            Opts.TimeReport = true;
+        } else if (strcmp(Arg, "-ftime-report=json") == 0) {
+            Opts.TimeReport = true;
+            Opts.TimeReportJSON = true;
+        } else if (strcmp(Arg, "--batch") == 0) {
+            Opts.Batch = true;
+        } else if (Arg[0] == '@') {
+            if (!cps::BatchCompiler::readManifest(Arg + 1, Opts.Inputs)) return false;
+        } else if (Arg[0] != '-') {
+            Opts.Inputs.push_back(Arg);
+        } else if (strncmp(Arg, "--client=", 9) == 0) {
+            Opts.ClientSocket = Arg + 9;
+        } else if (strcmp(Arg, "-o") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: -o requires an output path\n");
+                return false;
+            }
+            Opts.OutputPath = argv[++i];
+        } else {
+            fprintf(stderr, "Error: Unknown option %s\n", Arg);
+            return false;
+        }
+    }
+
+    if (Opts.RunJIT && (Opts.CompileOnly || !Opts.OutputPath.empty())) {
+        fprintf(stderr, "Error: --run/--lazy/--tiered cannot be combined with -c or -o\n");
+        return false;
+    }
+
+    if (Opts.CodeGenThreads > 1 && Opts.OutputPath.empty() && !Opts.CompileOnly && !Opts.Batch) {
+        fprintf(stderr, "Error: -j only applies to native output (-c or -o)\n");
+        return false;
+    }
+
+    if (Opts.Lazy && Opts.Tiered) {
+        fprintf(stderr, "Error: --lazy and --tiered are mutually exclusive\n");
+        return false;
+    }
+
+    if (Opts.Batch) {
+        if (Opts.RunJIT || !Opts.ServerSocket.empty() || !Opts.ClientSocket.empty() || !Opts.CacheDir.empty() ||
+            Opts.TimeReport || Opts.CodeGenThreads > 1) {
+            fprintf(stderr, "Error: --batch only supports -O, -c, -o <dir> and --workers\n");
+            return false;
+        }
+        if (Opts.Inputs.empty()) {
+            fprintf(stderr, "Error: --batch requires input files or an @manifest\n");
+            return false;
+        }
+        return true;
+    }
+
+    if (Opts.Inputs.size() > 1) {
+        fprintf(stderr, "Error: Multiple input files require --batch\n");
+        return false;
+    }
+
+    if (!Opts.ClientSocket.empty()) {
+        if (Opts.Lazy || Opts.Tiered || Opts.TimeReport || Opts.CodeGenThreads > 1) {
+            fprintf(stderr, "Error: --client only supports --run, -c and -o\n");
+            return false;
+        }
+        if (!Opts.RunJIT && !Opts.CompileOnly && Opts.OutputPath.empty()) {
+            Opts.OutputPath = "a.out";
+        }
+    }
+
+    if (Opts.CompileOnly && Opts.OutputPath.empty()) {
+        Opts.OutputPath = "a.o";
+    }
+    return true;
+}
+
+// Memory-maps the input file, or reads stdin when no file was given. The
+// lexer scans this buffer in place, so it must outlive the compile.
+static std::unique_ptr<llvm::MemoryBuffer> readSource(const DriverOptions &Opts) {
+    std::string Path = Opts.Inputs.empty() ? "-" : Opts.Inputs[0];
+    auto Buffer = llvm::MemoryBuffer::getFileOrSTDIN(Path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if (!Buffer) {
+        fprintf(stderr, "Error: Cannot read %s: %s\n",
+                Path == "-" ? "stdin" : Path.c_str(),
+                Buffer.getError().message().c_str());
+        return nullptr;
+    }
+    return std::move(*Buffer);
+}
+
+// The cache key covers every flag that changes the cached artifact.
+static std::string getCacheFlags(const DriverOptions &Opts, unsigned OptLevel) {
+    std::string Flags = "-O" + std::to_string(OptLevel);
+    if (!Opts.OutputPath.empty()) {
+        // -j N splits the module into N parts with no inlining between them.
+        if (Opts.CodeGenThreads > 1) return Flags + " obj -j" + std::to_string(Opts.CodeGenThreads);
+        return Flags + " obj";
+    }
+    if (Opts.Tiered) return Flags + " tiered";
+    if (Opts.RunJIT) return Flags + " jit";
+    return Flags + " ir";
+}
+
+static int finishObject(const DriverOptions &Opts, llvm::ArrayRef<char> Object, cps::TimeReport *Timer = nullptr) {
+    cps::TimeReport::Scope Linking(Timer, Opts.CompileOnly ? "write" : "link");
+    if (Opts.CompileOnly) {
+        return cps::ObjectEmitter::writeFile(Opts.OutputPath, Object) ? 0 : 1;
+    }
+
+    llvm::SmallString<128> ObjectPath;
+    if (llvm::sys::fs::createTemporaryFile("cps", "o", ObjectPath)) {
+        fprintf(stderr, "Error: Cannot create temporary object file\n");
+        return 1;
+    }
+
+    bool Ok = cps::ObjectEmitter::writeFile(ObjectPath.str().str(), Object) &&
+              cps::ObjectEmitter::linkExecutable(ObjectPath.str().str(), Opts.OutputPath);
+    llvm::sys::fs::remove(ObjectPath);
+    return Ok ? 0 : 1;
+}
+
+static int finishModule(Backends &B,
+                        std::unique_ptr<llvm::Module> M,
+                        std::unique_ptr<llvm::LLVMContext> Ctx,
+                        cps::TimeReport *Timer = nullptr) {
+    if (B.TieredRunner) {
+        if (!B.TieredRunner->addModule(std::move(M), std::move(Ctx))) return 1;
+        return B.TieredRunner->runMain();
+    }
+
+    if (B.Runner) {
+        if (!B.Runner->addModule(std::move(M), std::move(Ctx))) return 1;
+        return B.Runner->runMain();
+    }
+
+    cps::TimeReport::Scope Emitting(Timer, "emit");
+    M->print(llvm::errs(), nullptr);
     return 0;
 }
+
+static int finishBitcode(Backends &B, llvm::ArrayRef<char> Bitcode, const char *What) {
+    auto Ctx = std::make_unique<llvm::LLVMContext>();
+    llvm::MemoryBufferRef Buffer(llvm::StringRef(Bitcode.data(), Bitcode.size()), What);
+    auto M = llvm::parseBitcodeFile(Buffer, *Ctx);
+    if (!M) {
+        fprintf(stderr, "Error: Corrupt %s: %s\n", What, llvm::toString(M.takeError()).c_str());
+        return 1;
+    }
+    return finishModule(B, std::move(*M), std::move(Ctx));
+}
+
+// Runs a module the compile server has already compiled. The server spawns
+// this instead of forking itself, so the program starts in a fresh
+// single-threaded process.
+static int runBitcodeFile(const std::string &Path) {
+    auto Buffer = llvm::MemoryBuffer::getFile(Path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if (!Buffer) {
+        fprintf(stderr, "Error: Cannot read %s: %s\n", Path.c_str(), Buffer.getError().message().c_str());
+        return 1;
+    }
+
+    Backends B;
+    B.Runner = std::make_unique<cps::JIT>();
+    if (!B.Runner->isValid()) return 1;
+    return finishBitcode(B, llvm::ArrayRef<char>((*Buffer)->getBufferStart(), (*Buffer)->getBufferSize()),
+                         "bitcode file");
+}
+
+static unsigned getWorkerCount(const DriverOptions &Opts) {
+    if (Opts.Workers) return Opts.Workers;
+    unsigned Cores = std::thread::hardware_concurrency();
+    return Cores ? Cores : 1;
+}
+
+// Hands the compile to a running `cpsc --server` instead of doing it here.
+static int runClient(const DriverOptions &Opts) {
+    cps::CompileRequest Req;
+    Req.Mode = Opts.RunJIT ? cps::RequestMode::Run : cps::RequestMode::Object;
+    Req.OptLevel = Opts.OptLevel;
+    auto Buffer = readSource(Opts);
+    if (!Buffer) return 1;
+    Req.Source = Buffer->getBuffer().str();
+
+    // The program runs on the server, so INPUT reads what this process was
+    // given, sent up front. When the source itself came from stdin there is
+    // none left, and a terminal is not read so the client cannot hang.
+    if (Req.Mode == cps::RequestMode::Run && !Opts.Inputs.empty() &&
+        !llvm::sys::Process::StandardInIsUserInput()) {
+        auto Input = llvm::MemoryBuffer::getSTDIN();
+        if (!Input) {
+            fprintf(stderr, "Error: Cannot read stdin: %s\n", Input.getError().message().c_str());
+            return 1;
+        }
+        Req.Input = (*Input)->getBuffer().str();
+    }
+
+    cps::CompileResponse Resp;
+    if (!cps::sendCompileRequest(Opts.ClientSocket, Req, Resp)) return 1;
+    if (!Resp.Ok) {
+        fprintf(stderr, "%s", Resp.Payload.c_str());
+        return Resp.ExitCode ? Resp.ExitCode : 1;
+    }
+
+    if (Req.Mode == cps::RequestMode::Run) {
+        fwrite(Resp.Payload.data(), 1, Resp.Payload.size(), stdout);
+        fflush(stdout);
+        return Resp.ExitCode;
+    }
+    return finishObject(Opts, llvm::ArrayRef<char>(Resp.Payload.data(), Resp.Payload.size()));
+}
+
+// Compiles the input program and hands the result to the selected
+// backend. Returns the process exit code.
+static int compileProgram(const DriverOptions &Opts, cps::CompileCache *Cache, cps::TimeReport *Timer) {
+    // Tier 0 is always -O0; hot functions are re-optimized in the background.
+    unsigned OptLevel = Opts.Tiered ? 0 : Opts.OptLevel;
+    bool EmitObject = !Opts.OutputPath.empty();
+
+    // Created before compiling so that they outlive the context handed to them.
+    Backends B;
+    if (Opts.Tiered) {
+        B.TieredRunner = std::make_unique<cps::TieredJIT>(Opts.TierThreshold);
+        if (!B.TieredRunner->isValid()) return 1;
+    } else if (Opts.RunJIT) {
+        B.Runner = std::make_unique<cps::JIT>(Opts.Lazy);
+        if (!B.Runner->isValid()) return 1;
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> Buffer;
+    {
+        cps::TimeReport::Scope Reading(Timer, "read");
+        Buffer = readSource(Opts);
+    }
+    if (!Buffer) return 1;
+    std::string_view Source(Buffer->getBufferStart(), Buffer->getBufferSize());
+
+    std::string CacheKey;
+    cps::CacheEntryKind CacheKind = EmitObject ? cps::CacheEntryKind::Object : cps::CacheEntryKind::Bitcode;
+    if (Cache) {
+        CacheKey = cps::CompileCache::computeKey(Buffer->getBuffer(), getCacheFlags(Opts, OptLevel));
+
+        llvm::SmallVector<char, 0> Cached;
+        if (Cache->lookup(CacheKey, CacheKind, Cached)) {
+            return EmitObject ? finishObject(Opts, Cached) : finishBitcode(B, Cached, "cache entry");
+        }
+    }
+
+    cps::CompileOptions CompileOpts;
+    CompileOpts.OptLevel = OptLevel;
+    CompileOpts.CodeGenThreads = Opts.CodeGenThreads;
+    CompileOpts.Timer = Timer;
+
+    if (EmitObject) {
+        CompileOpts.Output = cps::CompileOutput::Object;
+        cps::CompileResult Compiled = cps::compile(Source, CompileOpts);
+        // A program with errors must not be cached: a hit would replay it
+        // without its diagnostics and exit 0.
+        if (!Compiled.Ok || Compiled.NumErrors) return 1;
+        if (Cache) Cache->store(CacheKey, CacheKind, Compiled.Object);
+        return finishObject(Opts, Compiled.Object, Timer);
+    }
+
+    CompileOpts.ConfigureModule = [&B](llvm::Module &M) {
+        if (B.TieredRunner) B.TieredRunner->configureModule(M);
+        if (B.Runner) B.Runner->configureModule(M);
+    };
+    cps::CompileResult Compiled = cps::compile(Source, CompileOpts);
+
+    // A module with errors is still printed, but never run or cached.
+    if (!Compiled.Ok && Opts.RunJIT) return 1;
+
+    if (Cache && Compiled.Ok && Compiled.NumErrors == 0) {
+        llvm::SmallVector<char, 0> Bitcode;
+        llvm::raw_svector_ostream OS(Bitcode);
+        llvm::WriteBitcodeToFile(*Compiled.Module, OS);
+        Cache->store(CacheKey, CacheKind, Bitcode);
+    }
+
+    int Code = finishModule(B, std::move(Compiled.Module), std::move(Compiled.Context), Timer);
+    return Compiled.Ok ? Code : 1;
+}
+
+int main(int argc, char **argv) {
+    DriverOptions Opts;
+    if (!parseArgs(argc, argv, Opts)) return 1;
+
+    if (!Opts.RunBitcodePath.empty()) return runBitcodeFile(Opts.RunBitcodePath);
+
+    if (!Opts.ServerSocket.empty()) {
+        cps::CompileServer Server(Opts.ServerSocket, getWorkerCount(Opts), Opts.RunTimeout);
+        return Server.run();
+    }
+
+    if (Opts.Batch) {
+        // In batch mode -o names the output directory; -c is implied.
+        cps::BatchCompiler Batch(Opts.OptLevel, getWorkerCount(Opts), Opts.OutputPath);
+        auto Start = std::chrono::steady_clock::now();
+        auto Results = Batch.run(Opts.Inputs);
+        double Wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+        cps::BatchCompiler::printSummary(Results, Wall, stderr);
+        for (const auto &R : Results) {
+            if (!R.Ok) return 1;
+        }
+        return 0;
+    }
+
+    if (!Opts.ClientSocket.empty()) return runClient(Opts);
+
+    std::unique_ptr<cps::CompileCache> Cache;
+    if (!Opts.CacheDir.empty() || Opts.CacheStats) {
+        if (Opts.CacheDir.empty()) Opts.CacheDir = cps::CompileCache::getDefaultDir();
+        Cache = std::make_unique<cps::CompileCache>(Opts.CacheDir, Opts.CacheSizeMB * 1024 * 1024);
+        if (!Cache->isValid()) Cache.reset();
+    }
+
+    if (Opts.CacheStats) {
+        if (!Cache) return 1;
+        cps::CacheStats Stats = Cache->loadStats();
+        fprintf(stderr, "cache %s: %llu hits, %llu misses, %llu evictions\n",
+                Cache->getDir().c_str(),
+                static_cast<unsigned long long>(Stats.Hits),
+                static_cast<unsigned long long>(Stats.Misses),
+                static_cast<unsigned long long>(Stats.Evictions));
+        return 0;
+    }
+
+    std::unique_ptr<cps::TimeReport> Timer;
+    if (Opts.TimeReport) Timer = std::make_unique<cps::TimeReport>();
+
+    int Code = compileProgram(Opts, Cache.get(), Timer.get());
+    if (Timer) {
+        if (Opts.TimeReportJSON) {
+            Timer->printJSON(stderr);
+        } else {
+            Timer->print(stderr);
+        }
+    }
+    return Code;
+}